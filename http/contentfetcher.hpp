@@ -31,6 +31,7 @@
 #include <vector>
 #include <memory>
 #include <exception>
+#include <functional>
 
 #include "constants.hpp"
 #include "sink.hpp"
@@ -44,23 +45,86 @@ public:
     virtual ~ContentFetcher() {}
 
     struct Options {
+        /** Dequeueing of requests waiting for per-host slot.
+         */
+        enum class Scheduling {
+            /** Higher priority always first.
+             */
+            strict
+            /** Share of slots proportional to priority + 1.
+             */
+            , weightedFair
+        };
+
         Options()
             : maxHostConnections(0),
               maxTotalConections(0),
               maxCacheConections(0),
-              pipelining(0)
+              pipelining(0),
+              shareDns(true),
+              shareSslSessions(true),
+              hostAffinity(true),
+              hostAffinityMaxLoad(1.25),
+              dnsCacheTtl(60),
+              dnsCacheNegativeTtl(5),
+              happyEyeballsTimeout(0),
+              maxHostTransfers(0),
+              scheduling(Scheduling::strict)
         {}
 
         unsigned long maxHostConnections;
         unsigned long maxTotalConections;
         unsigned long maxCacheConections;
         long pipelining;
+
+        /** Share DNS cache between all client threads.
+         */
+        bool shareDns;
+
+        /** Share TLS session cache between all client threads (saves full
+         *  handshakes when the same host is reached from another thread).
+         */
+        bool shareSslSessions;
+
+        /** Send requests to the same host via the same client thread to
+         *  maximize connection reuse. Requests are distributed in
+         *  round-robin manner otherwise.
+         */
+        bool hostAffinity;
+
+        /** Maximum load of host's client relative to average client load
+         *  (>= 1). Requests to overloaded client spill over to another one.
+         */
+        double hostAffinityMaxLoad;
+
+        /** Lifetime of resolved addresses in internal DNS cache (seconds).
+         *  Zero disables the cache, CURL resolves hosts by itself then.
+         */
+        long dnsCacheTtl;
+
+        /** Lifetime of failed DNS lookups (seconds).
+         */
+        long dnsCacheNegativeTtl;
+
+        /** Head start (milliseconds) given to connection attempt over
+         *  preferred address family (IPv6) before the other family is tried
+         *  in parallel (Happy Eyeballs). Zero means CURL's default (200 ms).
+         */
+        long happyEyeballsTimeout;
+
+        /** Maximum number of running transfers per host (and client thread).
+         *  Requests beyond the limit wait in per-host priority queues (see
+         *  RequestOptions::priority). Zero means no limit (and no queueing).
+         */
+        unsigned long maxHostTransfers;
+
+        Scheduling scheduling;
     };
 
     struct RequestOptions {
         RequestOptions()
             : followRedirects(true), lastModified(-1), reuse(true)
-            , timeout(-1), delay()
+            , timeout(-1), delay(), priority()
         {}
 
         bool followRedirects;
@@ -86,25 +150,48 @@ public:
          *  Zero means immediate action.
          */
         unsigned long delay;
+
+        /** Request priority, higher goes first. Applies to requests waiting
+         *  for per-host slot (see Options::maxHostTransfers).
+         */
+        int priority;
     };
 
-    void fetch(const std::string &location
-               , const ClientSink::pointer &sink
-               , const RequestOptions &options = RequestOptions());
+    /** Cancels fetch request. Can be called from any thread, any number of
+     *  times. Sink of unfinished request is notified by RequestAborted
+     *  error code (asynchronously, from a client thread); finished request
+     *  is left intact.
+     */
+    typedef std::function<void()> Cancel;
+
+    /** Fetches content from given location. Content is reported to the
+     *  sink as a whole unless sink is a StreamingClientSink; then body is
+     *  streamed as it arrives.
+     *
+     * \return function to cancel the request
+     */
+    Cancel fetch(const std::string &location
+                 , const ClientSink::pointer &sink
+                 , const RequestOptions &options = RequestOptions());
 
 private:
-    virtual void fetch_impl(const std::string &location
-                            , const ClientSink::pointer &sink
-                            , const RequestOptions &options) = 0;
+    /** Returns cancel function, empty if request cannot be cancelled (e.g.
+     *  it has already failed).
+     */
+    virtual Cancel fetch_impl(const std::string &location
+                              , const ClientSink::pointer &sink
+                              , const RequestOptions &options) = 0;
 };
 
 // inlines
 
-inline void ContentFetcher::fetch(const std::string &location
-                                  , const ClientSink::pointer &sink
-                                  , const RequestOptions &options)
+inline ContentFetcher::Cancel
+ContentFetcher::fetch(const std::string &location
+                      , const ClientSink::pointer &sink
+                      , const RequestOptions &options)
 {
-    return fetch_impl(location, sink, options);
+    if (auto cancel = fetch_impl(location, sink, options)) { return cancel; }
+    return []() {};
 }
 
 } // namespace http
@@ -33,6 +33,25 @@ void SinkBase::error()
     error_impl(std::current_exception());
 }
 
+void SinkBase::gather_impl(const Fragment::list &fragments
+                           , const FileInfo &stat
+                           , const Header::list *headers)
+{
+    if (fragments.size() == 1) {
+        // single fragment, no need to concatenate
+        const auto &fragment(fragments.front());
+        content_impl(fragment.data, fragment.size, stat, true, headers);
+        return;
+    }
+
+    std::string data;
+    data.reserve(Fragment::totalSize(fragments));
+    for (const auto &fragment : fragments) {
+        data.append(static_cast<const char*>(fragment.data), fragment.size);
+    }
+    content_impl(data.data(), data.size(), stat, true, headers);
+}
+
 void ServerSink::checkAborted() const
 {
     if (checkAborted_impl()) {
@@ -0,0 +1,279 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include "dbglog/dbglog.hpp"
+
+#include "accesslog.hpp"
+#include "types.hpp"
+
+namespace http { namespace detail {
+
+static_assert(sizeof(AccessRecord) == 512, "Unexpected access record size.");
+
+namespace {
+
+template <std::size_t Size>
+void copyString(char (&dst)[Size], const std::string &src)
+{
+    const auto size(std::min(src.size(), Size - 1));
+    std::memcpy(dst, src.data(), size);
+    dst[size] = '\0';
+}
+
+std::uint32_t microseconds(Request::Clock::duration d)
+{
+    const auto us(std::chrono::duration_cast<std::chrono::microseconds>
+                  (d).count());
+    if (us < 0) { return 0; }
+    return std::uint32_t(std::min<decltype(us)>(us, UINT32_MAX));
+}
+
+/** Formats time as ISO 8601 (UTC, microsecond precision).
+ */
+void formatTime(std::string &out, std::int64_t time)
+{
+    std::time_t seconds(time / 1000000);
+    tm bd;
+#ifdef _WIN32
+    ::gmtime_s(&bd, &seconds);
+#else
+    ::gmtime_r(&seconds, &bd);
+#endif
+
+    char buf[64];
+    auto size(std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &bd));
+    size += std::snprintf(buf + size, sizeof(buf) - size, ".%06dZ"
+                          , int(time % 1000000));
+    out.append(buf, size);
+}
+
+std::size_t roundUp(std::size_t value)
+{
+    std::size_t res(2);
+    while (res < value) { res <<= 1; }
+    return res;
+}
+
+} // namespace
+
+void AccessRecord::fill(std::uint64_t connection, const Request &request
+                        , const Response &response, std::size_t bytes)
+{
+    const auto now(Request::Clock::now());
+    const bool valid(request.received != Request::Clock::time_point());
+
+    this->time = std::chrono::duration_cast<std::chrono::microseconds>
+        ((valid ? request.receivedAt : std::chrono::system_clock::now())
+         .time_since_epoch()).count();
+    this->connection = connection;
+    this->bytes = bytes;
+    this->total = valid ? microseconds(now - request.received) : 0;
+    this->queue = valid ? microseconds(request.dispatched - request.received)
+        : 0;
+    this->status = std::uint16_t(response.numericCode());
+
+    copyString(method, request.method);
+    copyString(version, request.version);
+
+    uriSize = std::uint16_t(std::min(request.uri.size()
+                                     , std::size_t(uriCapacity)));
+    truncated = (uriSize < request.uri.size());
+    std::memcpy(uri, request.uri.data(), uriSize);
+}
+
+AccessLog::AccessLog(const std::string &path, std::size_t capacity)
+    : cells_(new Cell[roundUp(capacity)])
+    , mask_(roundUp(capacity) - 1)
+    , enqueuePos_(0), dequeuePos_(0), dropped_(0)
+    , path_(path), running_(true)
+{
+    for (std::size_t i(0); i <= mask_; ++i) {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    if (!path_.empty()) {
+        file_.exceptions(std::ios::badbit | std::ios::failbit);
+        file_.open(path_, std::ios_base::out | std::ios_base::app);
+
+        // write errors are handled by the writer thread
+        file_.exceptions(std::ios::goodbit);
+    }
+
+    thread_ = std::thread(&AccessLog::run, this);
+}
+
+AccessLog::~AccessLog()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_.join();
+}
+
+bool AccessLog::push(std::uint64_t connection, const Request &request
+                     , const Response &response, std::size_t bytes)
+{
+    auto pos(enqueuePos_.load(std::memory_order_relaxed));
+    Cell *cell;
+    for (;;) {
+        cell = &cells_[pos & mask_];
+        const auto seq(cell->sequence.load(std::memory_order_acquire));
+        const auto diff(std::intptr_t(seq) - std::intptr_t(pos));
+        if (!diff) {
+            if (enqueuePos_.compare_exchange_weak
+                (pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        } else if (diff < 0) {
+            // full
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->record.fill(connection, request, response, bytes);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool AccessLog::pop(AccessRecord &record)
+{
+    auto &cell(cells_[dequeuePos_ & mask_]);
+    const auto seq(cell.sequence.load(std::memory_order_acquire));
+    if (std::intptr_t(seq) - std::intptr_t(dequeuePos_ + 1) < 0) {
+        // empty
+        return false;
+    }
+
+    record = cell.record;
+    cell.sequence.store(dequeuePos_ + mask_ + 1, std::memory_order_release);
+    ++dequeuePos_;
+    return true;
+}
+
+void AccessLog::run()
+{
+    dbglog::thread_id("accesslog");
+
+    AccessRecord record;
+    std::string line;
+    std::string batch;
+    std::uint64_t reported(0);
+
+    for (bool running(true); running; ) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait_for(lock, std::chrono::milliseconds(100)
+                           , [this]() { return !running_; });
+            running = running_;
+        }
+
+        // drain the ring
+        while (pop(record)) {
+            line.clear();
+            formatTime(line, record.time);
+            line.append(" conn:");
+            line.append(std::to_string(record.connection));
+            line.append(" \"");
+            line.append(record.method);
+            line.push_back(' ');
+            line.append(record.uri, record.uriSize);
+            if (record.truncated) { line.append("..."); }
+            line.push_back(' ');
+            line.append(record.version);
+            line.append("\" ");
+            line.append(std::to_string(record.status));
+            line.push_back(' ');
+            line.append(std::to_string(record.bytes));
+            line.push_back(' ');
+            line.append(std::to_string(record.total));
+            line.push_back(' ');
+            line.append(std::to_string(record.queue));
+
+            if (path_.empty()) {
+                LOG(info3) << "HTTP " << line << '.';
+                continue;
+            }
+
+            line.push_back('\n');
+            batch.append(line);
+            if (batch.size() >= (1 << 16)) { write(batch); }
+        }
+
+        if (!batch.empty()) { write(batch); }
+
+        const auto dropped(dropped_.load(std::memory_order_relaxed));
+        if (dropped != reported) {
+            LOG(warn2) << "Access log dropped "
+                       << (dropped - reported) << " records.";
+            reported = dropped;
+        }
+    }
+}
+
+void AccessLog::write(std::string &batch)
+{
+    if (!file_.is_open()) {
+        // previous write failed, try again
+        file_.clear();
+        file_.open(path_, std::ios_base::out | std::ios_base::app);
+        if (file_) {
+            LOG(info3) << "Access log <" << path_ << "> reopened.";
+        } else {
+            file_.close();
+        }
+    }
+
+    if (file_.is_open()) {
+        file_.write(batch.data(), batch.size());
+        file_.flush();
+        if (file_) {
+            batch.clear();
+            return;
+        }
+
+        LOG(err2) << "Failed to write access log <" << path_
+                  << ">: " << std::strerror(errno) << ".";
+        file_.close();
+    }
+
+    dropped_.fetch_add(std::count(batch.begin(), batch.end(), '\n')
+                       , std::memory_order_relaxed);
+    batch.clear();
+}
+
+} } // namespace http::detail
@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef http_detail_accesslog_hpp_included_
+#define http_detail_accesslog_hpp_included_
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
+
+#include <boost/noncopyable.hpp>
+
+namespace http { namespace detail {
+
+struct Request;
+struct Response;
+
+/** Fixed-size binary access log record. Filled in by IO threads, formatted
+ *  by access log thread.
+ */
+struct AccessRecord {
+    /** Wall clock time of request reception, microseconds since epoch.
+     */
+    std::int64_t time;
+
+    /** Connection id.
+     */
+    std::uint64_t connection;
+
+    /** Number of bytes sent.
+     */
+    std::uint64_t bytes;
+
+    /** Time from reception to completed response (microseconds).
+     */
+    std::uint32_t total;
+
+    /** Time spent waiting in connection's queue (microseconds).
+     */
+    std::uint32_t queue;
+
+    /** Numeric status code.
+     */
+    std::uint16_t status;
+
+    /** Length of stored URI.
+     */
+    std::uint16_t uriSize;
+
+    /** URI was truncated.
+     */
+    bool truncated;
+
+    char method[15];
+    char version[16];
+
+    // whole record is 512 bytes long
+    enum { uriCapacity = 444 };
+    char uri[uriCapacity];
+
+    void fill(std::uint64_t connection, const Request &request
+              , const Response &response, std::size_t bytes);
+};
+
+/** Asynchronous access log.
+ *
+ *  Records are pushed into bounded lock-free ring buffer (multiple producers,
+ *  single consumer) and formatted and written by a background thread in
+ *  batches. When the ring is full the record is dropped and counted.
+ */
+class AccessLog : boost::noncopyable {
+public:
+    /** Creates access log writing to given file. Empty path means logging
+     *  via dbglog.
+     *
+     * \param path output file (opened for appending)
+     * \param capacity ring buffer capacity (rounded up to power of two)
+     */
+    AccessLog(const std::string &path, std::size_t capacity);
+
+    ~AccessLog();
+
+    /** Pushes record to the ring. Never blocks.
+     *
+     * \return false if record has been dropped
+     */
+    bool push(std::uint64_t connection, const Request &request
+              , const Response &response, std::size_t bytes);
+
+    /** Number of dropped records (ring overflow or failed write).
+     */
+    std::uint64_t dropped() const { return dropped_; }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        AccessRecord record;
+    };
+
+    bool pop(AccessRecord &record);
+
+    void run();
+
+    /** Writes batch to the file. Batch that cannot be written is dropped
+     *  and the file is reopened (now or on next write).
+     */
+    void write(std::string &batch);
+
+    std::unique_ptr<Cell[]> cells_;
+    std::size_t mask_;
+
+    /** Producer and consumer positions, padded to separate cache lines.
+     */
+    std::atomic<std::size_t> enqueuePos_;
+    char pad0_[64 - sizeof(std::atomic<std::size_t>)];
+    std::size_t dequeuePos_;
+    char pad1_[64 - sizeof(std::size_t)];
+
+    std::atomic<std::uint64_t> dropped_;
+
+    std::string path_;
+    std::ofstream file_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool running_;
+    std::thread thread_;
+};
+
+} } // namespace http::detail
+
+#endif // http_detail_accesslog_hpp_included_
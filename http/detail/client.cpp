@@ -25,8 +25,10 @@
  */
 
 #include <chrono>
+#include <cstring>
 
 #include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/chrono/duration.hpp>
 #include <boost/asio/steady_timer.hpp>
@@ -35,6 +37,7 @@
 
 #include "utility/streams.hpp"
 #include "utility/raise.hpp"
+#include "utility/uri.hpp"
 
 #include "../error.hpp"
 
@@ -42,6 +45,7 @@
 
 #include "curl.hpp"
 #include "types.hpp"
+#include "headers.hpp"
 
 namespace ba = boost::algorithm;
 
@@ -71,10 +75,12 @@ namespace http { namespace detail {
         }                                                               \
     } while (0)
 
-#define SETOPT(name, value)                                     \
-    CHECK_CURL_STATUS(::curl_easy_setopt(easy_, name, value)    \
+#define EASY_SETOPT(easy, name, value)                          \
+    CHECK_CURL_STATUS(::curl_easy_setopt(easy, name, value)     \
                       , "curl_easy_setopt")
 
+#define SETOPT(name, value) EASY_SETOPT(easy_, name, value)
+
 #define CHECK_CURLM_STATUS(op, what)                                    \
     do {                                                                \
         auto res(op);                                                   \
@@ -116,10 +122,8 @@ extern "C" {
 std::size_t http_curlclient_write(void *ptr, std::size_t size
                                   , std::size_t nmemb, void *userp)
 {
-    auto count(size * nmemb);
-    static_cast<ClientConnection*>(userp)
-        ->store(static_cast<char*>(ptr), count);
-    return count;
+    return static_cast<ClientConnection*>(userp)
+        ->store(static_cast<char*>(ptr), size * nmemb);
 }
 
 std::size_t http_curlclient_header(char *buf, std::size_t size
@@ -144,55 +148,179 @@ int http_curlclient_closesocket(void *clientp, ::curl_socket_t item)
 
 } // extern "C"
 
-ClientConnection
-::ClientConnection(CurlClient &owner
-                   , const std::string &location
-                   , const ClientSink::pointer &sink
-                   , const ContentFetcher::RequestOptions &options)
-    : easy_(::curl_easy_init()), headers_()
-    , location_(location), sink_(sink)
+namespace {
+
+/** Adapts buffered client sink to streaming interface: body is accumulated
+ *  and passed to the sink as a whole.
+ */
+class BufferedSink : public StreamingClientSink {
+public:
+    BufferedSink(const ClientSink::pointer &sink)
+        : sink_(sink), chunked_(false)
+    {}
+
+private:
+    /** Maximum size preallocated from Content-Length.
+     */
+    static constexpr long maxReserve = 1l << 28;
+
+    /** Size of the first block of body of unknown length, following blocks
+     *  double in size up to maxBlock.
+     */
+    static constexpr std::size_t minBlock = 1 << 16;
+    static constexpr std::size_t maxBlock = 1 << 22;
+
+    virtual void start_impl(const FileInfo &stat, long contentLength
+                            , const Resume&)
+    {
+        stat_ = stat;
+        if ((contentLength >= 0) && (contentLength <= maxReserve)) {
+            // exact size known up front
+            content_.reserve(contentLength);
+        } else {
+            chunked_ = true;
+        }
+    }
+
+    virtual bool chunk_impl(const void *data, std::size_t size) {
+        const auto *d(static_cast<const char*>(data));
+        if (!chunked_) {
+            content_.append(d, size);
+            return true;
+        }
+
+        // fill blocks, never reallocate
+        while (size) {
+            if (blocks_.empty()
+                || (blocks_.back().size() == blocks_.back().capacity()))
+            {
+                const auto block(blocks_.empty() ? minBlock
+                                 : std::min(2 * blocks_.back().capacity()
+                                            , maxBlock));
+                blocks_.emplace_back();
+                blocks_.back().reserve(block);
+            }
+
+            auto &block(blocks_.back());
+            const auto len(std::min(size, block.capacity() - block.size()));
+            block.append(d, len);
+            d += len;
+            size -= len;
+        }
+        return true;
+    }
+
+    virtual void finish_impl() {
+        if (chunked_) {
+            // assemble body once
+            if (blocks_.size() == 1) {
+                content_ = std::move(blocks_.front());
+            } else {
+                std::size_t total(0);
+                for (const auto &block : blocks_) { total += block.size(); }
+                content_.reserve(total);
+                for (const auto &block : blocks_) { content_.append(block); }
+            }
+            blocks_.clear();
+        }
+
+        sink_->content(std::move(content_), stat_);
+    }
+
+    virtual void content_impl(const void *data, std::size_t size
+                              , const FileInfo &stat, bool needCopy
+                              , const Header::list *headers)
+    {
+        sink_->content(data, size, stat, needCopy, headers);
+    }
+
+    virtual void error_impl(const std::exception_ptr &exc) {
+        sink_->error(exc);
+    }
+
+    virtual void error_impl(const std::error_code &ec
+                            , const std::string &message)
+    {
+        sink_->error(ec, message);
+    }
+
+    virtual void redirect_impl(const std::string &url, utility::HttpCode code
+                               , const CacheControl &cacheControl)
+    {
+        sink_->redirect(url, code, cacheControl);
+    }
+
+    virtual void notModified_impl() { sink_->notModified(); }
+
+    ClientSink::pointer sink_;
+    FileInfo stat_;
+    bool chunked_;
+    std::string content_;
+
+    /** Body of unknown length.
+     */
+    std::vector<std::string> blocks_;
+};
+
+constexpr long BufferedSink::maxReserve;
+constexpr std::size_t BufferedSink::minBlock;
+constexpr std::size_t BufferedSink::maxBlock;
+
+StreamingClientSink::pointer streamingSink(const ClientSink::pointer &sink)
+{
+    if (auto streaming
+        = std::dynamic_pointer_cast<StreamingClientSink>(sink))
+    {
+        return streaming;
+    }
+    return std::make_shared<BufferedSink>(sink);
+}
+
+} // namespace
+
+ClientConnection::ClientConnection(CurlClient &owner)
+    : owner_(owner), easy_(), headers_(), resolve_()
+    , body_(Body::pending), reusable_(false)
     , maxAge_(constants::cacheUnspecified)
     , expires_(constants::cacheUnspecified)
+    , traceId_(0)
+{}
+
+ClientConnection::~ClientConnection()
+{
+    close();
+}
+
+void ClientConnection::open(const Submission::pointer &submission
+                            , const std::string &resolve)
 {
+    const auto &options(submission->options);
+    location_ = submission->location;
+    submission_ = submission;
     LOG(info2) << "Starting transfer from <" << location_ << ">.";
 
-    if (!easy_) {
-        LOGTHROW(err2, Error)
-            << "Failed to create easy CURL handle.";
-    }
+    sink_ = streamingSink(submission->sink);
+    body_ = Body::pending;
+    reusable_ = false;
+    alive_ = std::make_shared<char>();
+    maxAge_ = expires_ = constants::cacheUnspecified;
+    headerName_.clear();
+    traceId_ = 0;
 
-    struct Guard {
-        ::CURL *easy;
-        ~Guard() { if (easy) {
-                LOG(warn2) << "Destroying easy handle due to an error.";
-                ::curl_easy_cleanup(easy);
-            } }
-    } guard{ easy_ };
+    // easy handle with defaults already set
+    easy_ = owner_.easy();
+
+    // NB: every per-request option is always set since easy handle is
+    // reused
 
     // set myself as a private data
     SETOPT(CURLOPT_PRIVATE, this);
-
-    // switch off SIGALARM
-    SETOPT(CURLOPT_NOSIGNAL, 1L);
-    // retain last modified time
-    SETOPT(CURLOPT_FILETIME, 1L);
-
-#if LIBCURL_VERSION_NUM >= 0x072100 // 7.33.0
-    // try to force HTTP/2.0
-    if (::curl_easy_setopt(easy_, CURLOPT_HTTP_VERSION,
-                           CURL_HTTP_VERSION_2_0) != CURLE_OK) {
-        // fallback force HTTP/1.1
-        SETOPT(CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
-    }
-#else
-    // force HTTP/1.1
-    SETOPT(CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
-#endif
+    SETOPT(CURLOPT_HEADERDATA, this);
+    SETOPT(CURLOPT_WRITEDATA, this);
 
     // use user agent
-    if (!options.userAgent.empty()) {
-        SETOPT(CURLOPT_USERAGENT, options.userAgent.c_str());
-    }
+    SETOPT(CURLOPT_USERAGENT, (options.userAgent.empty() ? nullptr
+                               : options.userAgent.c_str()));
 
     if (options.lastModified >= 0) {
         headers_ = ::curl_slist_append
@@ -216,46 +344,50 @@ ClientConnection
     SETOPT(CURLOPT_FOLLOWLOCATION, long(options.followRedirects));
 
     // single shot
-    if (!options.reuse) { SETOPT(CURLOPT_FORBID_REUSE, long(1)); }
+    SETOPT(CURLOPT_FORBID_REUSE, long(!options.reuse));
 
-    // set timeout
-    if (options.timeout > 0) {
-        SETOPT(CURLOPT_TIMEOUT_MS, long(options.timeout));
-    }
+    // set timeout (0 = no timeout)
+    SETOPT(CURLOPT_TIMEOUT_MS, long(std::max(options.timeout, 0l)));
 
     // set (optional) headers
-    if (headers_) { SETOPT(CURLOPT_HTTPHEADER, headers_); }
-
-    // calbacks
-
-    // header op
-    SETOPT(CURLOPT_HEADERFUNCTION, &http_curlclient_header);
-    SETOPT(CURLOPT_HEADERDATA, this);
+    SETOPT(CURLOPT_HTTPHEADER, headers_);
 
-    // write op
-    SETOPT(CURLOPT_WRITEFUNCTION, &http_curlclient_write);
-    SETOPT(CURLOPT_WRITEDATA, this);
+    // pre-resolved addresses
+    if (!resolve.empty()) {
+        resolve_ = ::curl_slist_append(resolve_, resolve.c_str());
+    }
+    SETOPT(CURLOPT_RESOLVE, resolve_);
 
     // and finally set url
     SETOPT(CURLOPT_URL, location_.c_str());
-
-    SETOPT(CURLOPT_OPENSOCKETFUNCTION, &http_curlclient_opensocket);
-    SETOPT(CURLOPT_OPENSOCKETDATA, &owner);
-    SETOPT(CURLOPT_CLOSESOCKETFUNCTION, &http_curlclient_closesocket);
-    SETOPT(CURLOPT_CLOSESOCKETDATA, &owner);
-
-    // release from guard
-    guard.easy = nullptr;
 }
 
-ClientConnection::~ClientConnection()
+void ClientConnection::close()
 {
-    if (easy_) { ::curl_easy_cleanup(easy_); }
-    if (headers_) { ::curl_slist_free_all(headers_); }
+    if (easy_) {
+        owner_.release(easy_, reusable_);
+        easy_ = nullptr;
+    }
+    if (headers_) {
+        ::curl_slist_free_all(headers_);
+        headers_ = nullptr;
+    }
+    if (resolve_) {
+        ::curl_slist_free_all(resolve_);
+        resolve_ = nullptr;
+    }
+
+    // release sink and invalidate pending resume
+    sink_.reset();
+    submission_.reset();
+    alive_.reset();
 }
 
 void ClientConnection::notify(::CURLcode result)
 {
+    // only cleanly finished handle is reused (e.g. no paused state left)
+    reusable_ = (result == CURLE_OK);
+
     if (result != CURLE_OK) {
         sink_->error(utility::makeError<Error>
                      ("Transfer of <%s> failed: <%d, %s>."
@@ -276,30 +408,12 @@ void ClientConnection::notify(::CURLcode result)
         logged = true;
 
         switch (httpCode / 100) {
-        case 2: {
-            // cool, we have some content, fetch info and report it
-            long int lastModified;
-            CHECK_CURL_STATUS(::curl_easy_getinfo
-                              (easy_, CURLINFO_FILETIME, &lastModified)
-                              , "curl_easy_getinfo");
-            char *contentType;
-            CHECK_CURL_STATUS(::curl_easy_getinfo
-                              (easy_, CURLINFO_CONTENT_TYPE, &contentType)
-                              , "curl_easy_getinfo");
-
-            // expires header
-            std::time_t expires(maxAge_);
-            if (maxAge_ == constants::cacheUnspecified) {
-                expires = expires_;
-            }
-
-            sink_->content(content_
-                           , http::SinkBase::FileInfo
-                           ((contentType ? contentType
-                             : "application/octet-stream")
-                            , lastModified, long(expires)));
+        case 2:
+            // cool, we have some content, finish it (empty body has not
+            // been started yet)
+            if (body_ == Body::pending) { begin(); }
+            sink_->finish();
             break;
-        }
 
         case 3: {
             switch (httpCode) {
@@ -409,9 +523,94 @@ void ClientConnection::notify(::CURLcode result)
     }
 }
 
-void ClientConnection::store(const char *data, std::size_t size)
+http::SinkBase::FileInfo ClientConnection::fileInfo()
+{
+    long int lastModified;
+    CHECK_CURL_STATUS(::curl_easy_getinfo
+                      (easy_, CURLINFO_FILETIME, &lastModified)
+                      , "curl_easy_getinfo");
+    char *contentType;
+    CHECK_CURL_STATUS(::curl_easy_getinfo
+                      (easy_, CURLINFO_CONTENT_TYPE, &contentType)
+                      , "curl_easy_getinfo");
+
+    // expires header
+    std::time_t expires(maxAge_);
+    if (maxAge_ == constants::cacheUnspecified) {
+        expires = expires_;
+    }
+
+    return http::SinkBase::FileInfo
+        ((contentType ? contentType : "application/octet-stream")
+         , lastModified, long(expires));
+}
+
+void ClientConnection::begin()
+{
+    long int httpCode(500);
+    CHECK_CURL_STATUS(::curl_easy_getinfo
+                      (easy_, CURLINFO_RESPONSE_CODE, &httpCode)
+                      , "curl_easy_getinfo");
+    if ((httpCode / 100) != 2) {
+        // body of error response is not interesting
+        body_ = Body::discarded;
+        return;
+    }
+
+#if CURL_AT_LEAST_VERSION(7, 55, 0)
+    ::curl_off_t contentLength(-1);
+    LOG_CURL_STATUS(::curl_easy_getinfo
+                    (easy_, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T
+                     , &contentLength)
+                    , "curl_easy_getinfo");
+#else
+    double contentLength(-1);
+    LOG_CURL_STATUS(::curl_easy_getinfo
+                    (easy_, CURLINFO_CONTENT_LENGTH_DOWNLOAD
+                     , &contentLength)
+                    , "curl_easy_getinfo");
+#endif
+
+    body_ = Body::streaming;
+
+    // resume is posted to the client thread, client or connection can be
+    // gone by then
+    auto link(owner_.link());
+    std::weak_ptr<void> alive(alive_);
+    auto *easy(easy_);
+    sink_->start(fileInfo(), long(contentLength), [link, alive, easy]()
+    {
+        auto l(link.lock());
+        if (!l) { return; }
+        l->post([alive, easy](CurlClient&)
+        {
+            if (alive.expired()) { return; }
+            LOG_CURL_STATUS(::curl_easy_pause(easy, CURLPAUSE_CONT)
+                            , "curl_easy_pause");
+        });
+    });
+}
+
+std::size_t ClientConnection::store(const char *data, std::size_t size)
 {
-    content_.append(data, size);
+    if (body_ == Body::pending) {
+        try {
+            begin();
+        } catch (...) {
+            // abort transfer
+            return 0;
+        }
+    }
+
+    if (body_ == Body::discarded) { return size; }
+
+    try {
+        return sink_->chunk(data, size) ? size : CURL_WRITEFUNC_PAUSE;
+    } catch (const std::exception &e) {
+        LOG(err2) << "Streaming sink of <" << location_
+                  << "> failed: <" << e.what() << ">; aborting transfer.";
+    }
+    return 0;
 }
 
 void ClientConnection::header(const char *data, std::size_t size)
@@ -449,58 +648,7 @@ void ClientConnection::header(const char *data, std::size_t size)
 void ClientConnection::processHeader()
 {
     if (ba::iequals(headerName_, "Cache-Control")) {
-        // cache control, parse
-        std::string token;
-        std::time_t ma(constants::cacheUnspecified);
-        std::time_t sma(constants::cacheUnspecified);
-        bool noCache(false);
-        bool private_(false);
-        bool public_(false);
-        bool mustRevalidate(false);
-
-        // process value (no exception, relaxed parsing)
-        std::istringstream is(headerValue_);
-        while (is) {
-            is >> token;
-            if (ba::istarts_with(token, "private")) {
-                private_ = true;
-            } else if (ba::istarts_with(token, "public")) {
-                public_ = true;
-            } if (ba::istarts_with(token, "no-cache")) {
-                noCache = true;
-                break;
-            } else if (ba::istarts_with(token, "s-maxage=")) {
-				std::istringstream t(token);
-                t.ignore(9);
-                t >> sma;
-            } else if (ba::istarts_with(token, "max-age=")) {
-                std::istringstream t(token);
-                t.ignore(8);
-                t >> ma;
-            } else if (ba::istarts_with(token, "must-revalidate")) {
-                mustRevalidate = true;
-            }
-        }
-
-        // what to do with public?
-        (void) public_;
-
-        if (private_) {
-            // private -> we cannot cache it
-            maxAge_ = 0;
-        } else if (noCache) {
-            // cache forbidden
-            maxAge_ = 0;
-        } else if (mustRevalidate) {
-            maxAge_ = constants::mustRevalidate;
-        } else if (sma >= 0) {
-            maxAge_ = sma;
-        } else if (ma >= 0) {
-            maxAge_ = ma;
-        } else {
-            // have no idea
-            maxAge_ = constants::cacheUnspecified;
-        }
+        maxAge_ = parseCacheControl(headerValue_);
     }
 
     headerName_.clear();
@@ -522,9 +670,100 @@ int http_curlclient_timer(CURLM*, long int timeout, void *userp)
 
 } // extern "C"
 
-CurlClient::CurlClient(int id, const ContentFetcher::Options *options)
-    : multi_(::curl_multi_init())
+#define SHSETOPT(name, value)                                       \
+    do {                                                                \
+        auto res(::curl_share_setopt(share_, name, value));             \
+        if (res != CURLSHE_OK) {                                        \
+            LOGTHROW(err2, Error)                                       \
+                << "Failed to set share CURL option <" << #name         \
+                << ">:" << res << ", "                                  \
+                << ::curl_share_strerror(res)                           \
+                << ">.";                                                \
+        }                                                               \
+    } while (0)
+
+extern "C" {
+
+void http_curlshare_lock(::CURL*, ::curl_lock_data data
+                         , ::curl_lock_access, void *userp)
+{
+    static_cast<CurlShare*>(userp)->lock(data);
+}
+
+void http_curlshare_unlock(::CURL*, ::curl_lock_data data, void *userp)
+{
+    static_cast<CurlShare*>(userp)->unlock(data);
+}
+
+} // extern "C"
+
+CurlShare::pointer CurlShare::create(const ContentFetcher::Options *options)
+{
+    ContentFetcher::Options defaults;
+    if (!options) { options = &defaults; }
+
+    if (!options->shareDns && !options->shareSslSessions) {
+        return {};
+    }
+
+    return std::make_shared<CurlShare>(*options);
+}
+
+CurlShare::CurlShare(const ContentFetcher::Options &options)
+    : share_(::curl_share_init())
+{
+    if (!share_) {
+        LOGTHROW(err2, Error)
+            << "Failed to create share CURL handle.";
+    }
+
+    try {
+        SHSETOPT(CURLSHOPT_LOCKFUNC, &http_curlshare_lock);
+        SHSETOPT(CURLSHOPT_UNLOCKFUNC, &http_curlshare_unlock);
+        SHSETOPT(CURLSHOPT_USERDATA, this);
+
+        if (options.shareDns) {
+            SHSETOPT(CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        }
+        if (options.shareSslSessions) {
+            SHSETOPT(CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        }
+    } catch (...) {
+        ::curl_share_cleanup(share_);
+        throw;
+    }
+}
+
+CurlShare::~CurlShare()
+{
+    auto res(::curl_share_cleanup(share_));
+    if (res != CURLSHE_OK) {
+        LOG(err2) << "Failed to destroy share CURL handle: "
+                  << ::curl_share_strerror(res) << ".";
+    }
+}
+
+void CurlShare::lock(::curl_lock_data data)
+{
+    mutexes_[data].lock();
+}
+
+void CurlShare::unlock(::curl_lock_data data)
+{
+    mutexes_[data].unlock();
+}
+
+CurlClient::CurlClient(int id, const ContentFetcher::Options *options
+                       , Metrics *metrics, Tracer *tracer
+                       , const CurlShare::pointer &share
+                       , DnsCache *dnsCache)
+    : metrics_(metrics), tracer_(tracer)
+    , link_(std::make_shared<Link>(this))
+    , happyEyeballsTimeout_(options ? options->happyEyeballsTimeout : 0)
+    , share_(share), dnsCache_(dnsCache)
+    , multi_(::curl_multi_init())
     , work_(std::ref(ios_))
+    , handlers_(0), load_(0), scheduler_(options), submissions_(nullptr)
     , timer_(ios_)
     , runningTransfers_()
 {
@@ -561,8 +800,114 @@ CurlClient::CurlClient(int id, const ContentFetcher::Options *options)
     start(id);
 }
 
+::CURL* CurlClient::easy()
+{
+    if (!easyPool_.empty()) {
+        auto *easy(easyPool_.back());
+        easyPool_.pop_back();
+        return easy;
+    }
+
+    auto *easy(::curl_easy_init());
+    if (!easy) {
+        LOGTHROW(err2, Error)
+            << "Failed to create easy CURL handle.";
+    }
+
+    struct Guard {
+        ::CURL *easy;
+        ~Guard() { if (easy) {
+                LOG(warn2) << "Destroying easy handle due to an error.";
+                ::curl_easy_cleanup(easy);
+            } }
+    } guard{ easy };
+
+    // defaults shared by all requests, set only once per handle
+
+    // switch off SIGALARM
+    EASY_SETOPT(easy, CURLOPT_NOSIGNAL, 1L);
+    // retain last modified time
+    EASY_SETOPT(easy, CURLOPT_FILETIME, 1L);
+
+#if LIBCURL_VERSION_NUM >= 0x072100 // 7.33.0
+    // try to force HTTP/2.0
+    if (::curl_easy_setopt(easy, CURLOPT_HTTP_VERSION,
+                           CURL_HTTP_VERSION_2_0) != CURLE_OK) {
+        // fallback force HTTP/1.1
+        EASY_SETOPT(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+    }
+#else
+    // force HTTP/1.1
+    EASY_SETOPT(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+#endif
+
+    // calbacks
+    EASY_SETOPT(easy, CURLOPT_HEADERFUNCTION, &http_curlclient_header);
+    EASY_SETOPT(easy, CURLOPT_WRITEFUNCTION, &http_curlclient_write);
+
+    EASY_SETOPT(easy, CURLOPT_OPENSOCKETFUNCTION
+                , &http_curlclient_opensocket);
+    EASY_SETOPT(easy, CURLOPT_OPENSOCKETDATA, this);
+    EASY_SETOPT(easy, CURLOPT_CLOSESOCKETFUNCTION
+                , &http_curlclient_closesocket);
+    EASY_SETOPT(easy, CURLOPT_CLOSESOCKETDATA, this);
+
+#if CURL_AT_LEAST_VERSION(7, 59, 0)
+    // IPv6 head start
+    if (happyEyeballsTimeout_ > 0) {
+        EASY_SETOPT(easy, CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS
+                    , happyEyeballsTimeout_);
+    }
+#endif
+
+    // caches shared with other clients
+    if (share_) {
+        EASY_SETOPT(easy, CURLOPT_SHARE, share_->handle());
+    }
+
+    // release from guard
+    guard.easy = nullptr;
+    return easy;
+}
+
+void CurlClient::release(::CURL *easy, bool reusable)
+{
+    if (!reusable || (easyPool_.size() >= maxPooled)) {
+        ::curl_easy_cleanup(easy);
+        return;
+    }
+    easyPool_.push_back(easy);
+}
+
+std::unique_ptr<ClientConnection>
+CurlClient::connection(const Submission::pointer &submission
+                       , const std::string &resolve)
+{
+    std::unique_ptr<ClientConnection> conn;
+    if (freeConnections_.empty()) {
+        conn.reset(new ClientConnection(*this));
+    } else {
+        conn = std::move(freeConnections_.back());
+        freeConnections_.pop_back();
+    }
+
+    try {
+        conn->open(submission, resolve);
+    } catch (...) {
+        conn->close();
+        throw;
+    }
+    return conn;
+}
+
 CurlClient::~CurlClient()
 {
+    // no more cancellations from outside
+    {
+        std::lock_guard<std::mutex> lock(link_->mutex);
+        link_->client = nullptr;
+    }
+
     if (!multi_) { return; }
 
     // stop the machinery: this gives us free hand to manipulate with
@@ -576,6 +921,20 @@ CurlClient::~CurlClient()
     }
     sockets_.clear();
 
+    // no more lookups bound to our ios
+    if (dnsCache_) { dnsCache_->forget(ios_); }
+
+    // drop submissions never taken by the worker
+    for (auto *s(submissions_.exchange(nullptr)); s; ) {
+        auto *next(s->next);
+        s->self.reset();
+        s = next;
+    }
+
+    freeConnections_.clear();
+    for (auto *easy : easyPool_) { ::curl_easy_cleanup(easy); }
+    easyPool_.clear();
+
     LOG_CURLM_STATUS(::curl_multi_cleanup(multi_)
                      , "curl_multi_cleanup");
 }
@@ -601,7 +960,11 @@ void CurlClient::run(unsigned int id)
 
     for (;;) {
         try {
-            ios_.run();
+            // run handlers one by one to count them
+            while (ios_.run_one()) {
+                handlers_.store(handlers_.load(std::memory_order_relaxed) + 1
+                                , std::memory_order_relaxed);
+            }
             LOG(info2) << "Terminated HTTP client worker id:" << id << ".";
             return;
         } catch (const std::exception &e) {
@@ -621,71 +984,345 @@ void CurlClient::add(std::unique_ptr<ClientConnection> &&conn)
                        (multi_, c->handle())
                        , "curl_multi_add_handle");
     conn.release();
+
+    const auto &submission(c->submission());
+    submission->state = Submission::State::running;
+    submission->connection = c;
+
+    count(Metrics::Counter::clientTransfersStarted);
+    if (tracer_) { c->trace(tracer_->sample()); }
 }
 
 void CurlClient::remove(ClientConnection *conn)
 {
     if (connections_.erase(conn)) {
         std::unique_ptr<ClientConnection> ptr(conn);
+        const auto submission(conn->submission());
         LOG(debug) << "Removing connection " << conn->handle();
         CHECK_CURLM_STATUS(::curl_multi_remove_handle
                            (multi_, conn->handle())
                            , "curl_multi_remove_handle");
+
+        // recycle connection and its easy handle
+        conn->close();
+        if (freeConnections_.size() < maxPooled) {
+            freeConnections_.push_back(std::move(ptr));
+        }
+
+        submission->connection = nullptr;
+        done(*submission);
     }
 }
 
-void CurlClient::fetch(const std::string &location
-                       , const ClientSink::pointer &sink
-                       , const ContentFetcher::RequestOptions &options)
+ContentFetcher::Cancel
+CurlClient::fetch(const std::string &location
+                  , const ClientSink::pointer &sink
+                  , const ContentFetcher::RequestOptions &options)
 {
-    if (!options.delay) {
-        // immediate query
-        ios_.post([=]() -> void
-        {
-            try {
-                return add
-                    (std::unique_ptr<ClientConnection>
-                     (new ClientConnection(*this, location, sink, options)));
-            } catch (...) {
-                sink->error();
+    ++load_;
+
+    auto submission(std::make_shared<Submission>(location, sink, options));
+
+    // cancel function holds neither the client nor the submission
+    std::weak_ptr<Link> link(link_);
+    std::weak_ptr<Submission> weak(submission);
+    ContentFetcher::Cancel cancel([link, weak]()
+    {
+        // gone submission is finished one
+        if (auto submission = weak.lock()) {
+            if (auto l = link.lock()) {
+                l->post([submission](CurlClient &client)
+                {
+                    client.cancel(submission);
+                });
             }
-        });
-        return;
+        }
+    });
+
+    if (!options.delay) {
+        // immediate query: push to submission queue, queue holds reference
+        auto *s(submission.get());
+        s->self = std::move(submission);
+        auto *head(submissions_.load(std::memory_order_relaxed));
+        do {
+            s->next = head;
+        } while (!submissions_.compare_exchange_weak
+                 (head, s, std::memory_order_release
+                  , std::memory_order_relaxed));
+
+        // first submission in the batch wakes up the worker
+        if (!head) { ios_.post([this]() { drain(); }); }
+        return cancel;
     }
 
     // delayed query
     auto timer(std::make_shared<asio::steady_timer>
                (ios_, std::chrono::milliseconds(options.delay)));
+    submission->state = Submission::State::delayed;
+    submission->timer = timer;
 
-    // NB: we need to capture timer otherwise it would go out of scope
-    timer->async_wait([timer, this, location, sink, options]
-                      (const bs::error_code &ec) mutable -> void
+    // NB: timer is kept alive by the submission
+    timer->async_wait([this, submission](const bs::error_code &ec) -> void
     {
+        // cancelled
+        if (submission->state == Submission::State::finished) { return; }
+
+        submission->state = Submission::State::pending;
+        submission->timer.reset();
         if (ec != asio::error::operation_aborted) {
-            try {
-                add(std::unique_ptr<ClientConnection>
-                    (new ClientConnection(*this, location, sink, options)));
-            } catch (...) {
-                sink->error();
-            }
-            return;
+            return submit(submission);
         }
 
         // forward error
-        sink->error(ec);
+        submission->state = Submission::State::finished;
+        --load_;
+        submission->sink->error(ec);
     });
+    return cancel;
+}
+
+void CurlClient::cancel(const Submission::pointer &submission)
+{
+    switch (submission->state) {
+    case Submission::State::finished:
+        return;
+
+    case Submission::State::pending:
+        // not drained yet, drain skips finished submission
+        --load_;
+        break;
+
+    case Submission::State::delayed:
+        // timer handler skips finished submission
+        submission->timer->cancel();
+        submission->timer.reset();
+        --load_;
+        break;
+
+    case Submission::State::queued:
+        scheduler_.cancel(submission);
+        --load_;
+        break;
+
+    case Submission::State::admitted:
+        // being resolved, resolved() skips finished submission
+        done(*submission);
+        break;
+
+    case Submission::State::running:
+        // stop the transfer, connection (and its easy handle) is recycled;
+        // started transfer must end somehow
+        remove(submission->connection);
+        count(Metrics::Counter::clientTransfersFailed);
+        break;
+    }
+
+    LOG(info2) << "Transfer from <" << submission->location
+               << "> cancelled.";
+    submission->state = Submission::State::finished;
+    count(Metrics::Counter::clientTransfersCancelled);
+    submission->sink->error(make_error_code
+                            (utility::HttpCode::RequestAborted)
+                            , "Transfer of <" + submission->location
+                            + "> cancelled.");
+}
+
+void CurlClient::connected(::CURL *easy)
+{
+#if CURL_AT_LEAST_VERSION(7, 61, 0)
+    long connects(0);
+    if ((::curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects)
+         != CURLE_OK) || !connects)
+    {
+        // reused connection
+        return;
+    }
+
+    ::curl_off_t lookup(0), connect(0);
+    char *ip(nullptr);
+    if ((::curl_easy_getinfo(easy, CURLINFO_NAMELOOKUP_TIME_T, &lookup)
+         != CURLE_OK)
+        || (::curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME_T, &connect)
+            != CURLE_OK)
+        || (::curl_easy_getinfo(easy, CURLINFO_PRIMARY_IP, &ip)
+            != CURLE_OK)
+        || !ip || (connect < lookup))
+    {
+        return;
+    }
+
+    // IPv6 address is the only one with colons
+    const auto family(std::strchr(ip, ':') ? Family::ipv6 : Family::ipv4);
+    connectLatency_[static_cast<unsigned>(family)]
+        .record(std::uint64_t(connect - lookup));
+#else
+    (void) easy;
+#endif
+}
+
+void CurlClient::drain()
+{
+    // take all, reverse to submission order
+    auto *s(submissions_.exchange(nullptr, std::memory_order_acquire));
+    Submission *head(nullptr);
+    while (s) {
+        auto *next(s->next);
+        s->next = head;
+        head = s;
+        s = next;
+    }
+
+    while (head) {
+        auto submission(std::move(head->self));
+        head = head->next;
+
+        // not cancelled in the meantime
+        if (submission->state == Submission::State::pending) {
+            submit(submission);
+        }
+    }
+}
+
+namespace {
+
+/** Is host an IP address literal?
+ */
+bool isAddress(const std::string &host)
+{
+    bs::error_code ec;
+    if (!host.empty() && (host.front() == '[')) {
+        ip::address::from_string(host.substr(1, host.size() - 2), ec);
+    } else {
+        ip::address::from_string(host, ec);
+    }
+    return !ec;
+}
+
+} // namespace
+
+void CurlClient::submit(const Submission::pointer &submission)
+{
+    if (scheduler_.enabled()) {
+        submission->host = Scheduler::hostKey(submission->location);
+        if (!scheduler_.admit(submission)) {
+            // waits for free host slot
+            submission->state = Submission::State::queued;
+            count(Metrics::Counter::clientTransfersQueued);
+            return;
+        }
+    }
+
+    submission->state = Submission::State::admitted;
+    launch(submission);
+}
+
+void CurlClient::launch(const Submission::pointer &submission)
+{
+    // cancelled while waiting for launch
+    if (submission->state != Submission::State::admitted) { return; }
+
+    try {
+        if (dnsCache_) {
+            const utility::Uri uri(submission->location);
+            const auto host(uri.host());
+            if (!host.empty() && !isAddress(host)) {
+                const auto port((uri.port() > 0)
+                                ? uri.port()
+                                : ((uri.scheme() == "https") ? 443 : 80));
+                const auto service(boost::lexical_cast<std::string>(port));
+
+                // handler is either called right away (cache hit) or posted
+                // to our ios
+                dnsCache_->resolve
+                    (ios_, host, service
+                     , [this, submission, host, service]
+                     (const bs::error_code &ec
+                      , const DnsCache::EndpointsPointer &endpoints)
+                {
+                    resolved(submission, host, service, ec, endpoints);
+                });
+                return;
+            }
+        }
+
+        // no cache or nothing to resolve
+        add(connection(submission));
+    } catch (...) {
+        submission->sink->error();
+        done(*submission);
+    }
+}
+
+void CurlClient::done(Submission &submission)
+{
+    submission.state = Submission::State::finished;
+    --load_;
+    if (!scheduler_.enabled()) { return; }
+
+    if (auto next = scheduler_.release(submission.host)) {
+        // start next waiting submission (posted to avoid recursion when
+        // submissions fail right away)
+        next->state = Submission::State::admitted;
+        ios_.post([this, next]() { launch(next); });
+    }
+}
+
+void CurlClient::resolved(const Submission::pointer &submission
+                          , const std::string &host
+                          , const std::string &service
+                          , const bs::error_code &ec
+                          , const DnsCache::EndpointsPointer &endpoints)
+{
+    // cancelled while being resolved
+    if (submission->state != Submission::State::admitted) { return; }
+
+    try {
+        if (ec) {
+            LOGTHROW(err2, Error)
+                << "Failed to resolve <" << host << "> for <"
+                << submission->location << ">: " << ec.message() << ".";
+        }
+
+        // feed addresses to CURL: HOST:PORT:ADDRESS[,ADDRESS]...
+        auto resolve(host);
+        resolve.push_back(':');
+        resolve.append(service);
+        char separator(':');
+        for (const auto &endpoint : *endpoints) {
+            resolve.push_back(separator);
+            separator = ',';
+
+            const auto address(endpoint.address());
+            if (address.is_v6()) {
+                resolve.push_back('[');
+                resolve.append(address.to_string());
+                resolve.push_back(']');
+            } else {
+                resolve.append(address.to_string());
+            }
+        }
+
+        add(connection(submission, resolve));
+    } catch (...) {
+        submission->sink->error();
+        done(*submission);
+    }
 }
 
 ::curl_socket_t CurlClient::open_cb(::curlsocktype purpose,
                                     ::curl_sockaddr *address)
 {
-    if (purpose == CURLSOCKTYPE_IPCXN && address->family == AF_INET)
+    // NB: CURL may open both IPv6 and IPv4 sockets for single transfer
+    // (Happy Eyeballs); socket of the losing attempt is closed via close_cb
+    if ((purpose == CURLSOCKTYPE_IPCXN)
+        && ((address->family == AF_INET) || (address->family == AF_INET6)))
     {
         // remember socket
         auto socket(Socket::create(ios_));
 
         bs::error_code ec;
-        socket->socket.open(ip::tcp::v4(), ec);
+        socket->socket.open((address->family == AF_INET6)
+                            ? ip::tcp::v6() : ip::tcp::v4(), ec);
 
         if (ec) {
             LOG(warn2) << "Failed to open TCP socket: <" << ec << ">.";
@@ -696,6 +1333,7 @@ void CurlClient::fetch(const std::string &location
         // LOG(info4)
         //     << "Opened socket " << socket.get() << ", " << native << ".";
         sockets_.insert(Socket::map::value_type(native, std::move(socket)));
+        count(Metrics::Counter::clientSocketsOpened);
         return native;
     }
 
@@ -902,8 +1540,35 @@ void CurlClient::action(::curl_socket_t socket, int what)
             continue;
         }
 
+        if (msg->data.result == CURLE_OK) { connected(msg->easy_handle); }
+
+        if (metrics_) {
+            count((msg->data.result == CURLE_OK)
+                  ? Metrics::Counter::clientTransfersCompleted
+                  : Metrics::Counter::clientTransfersFailed);
+#if CURL_AT_LEAST_VERSION(7, 55, 0)
+            ::curl_off_t size(0);
+            ::curl_easy_getinfo(msg->easy_handle
+                                , CURLINFO_SIZE_DOWNLOAD_T, &size);
+#else
+            double size(0);
+            ::curl_easy_getinfo(msg->easy_handle
+                                , CURLINFO_SIZE_DOWNLOAD, &size);
+#endif
+            count(Metrics::Counter::clientBytesIn, std::uint64_t(size));
+        }
+
         // notify finished transfer
-        conn->notify(msg->data.result);
+        if (conn->traceId()) {
+            const auto start(Tracer::Clock::now());
+            conn->notify(msg->data.result);
+            const auto now(Tracer::Clock::now());
+            tracer_->span("client.transfer", conn->traceId()
+                          , conn->started(), start, conn->location());
+            tracer_->span("client.notify", conn->traceId(), start, now);
+        } else {
+            conn->notify(msg->data.result);
+        }
 
         // get rid of connection
         remove(conn);
@@ -914,26 +1579,25 @@ void CurlClient::action(::curl_socket_t socket, int what)
 
 namespace http {
 
-void Http::Detail::fetch_impl(const std::string &location
-                              , const ClientSink::pointer &sink
-                              , const ContentFetcher::RequestOptions &options)
+ContentFetcher::Cancel
+Http::Detail::fetch_impl(const std::string &location
+                         , const ClientSink::pointer &sink
+                         , const ContentFetcher::RequestOptions &options)
 {
-    // must be under lock
     try {
-        std::unique_lock<std::mutex> lock(clientMutex_);
+        // lock-free access, dispatcher is immutable
+        const auto dispatcher(std::atomic_load(&dispatcher_));
 
-        if (clients_.empty()) {
+        if (!dispatcher) {
             LOGTHROW(err2, Error)
                 << "Cannot perform fetch request: no client is running.";
         }
 
-        (*currentClient_)->fetch(location, sink, options);
-        if (++currentClient_ == clients_.end()) {
-            currentClient_ = clients_.begin();
-        }
+        return dispatcher->client(location).fetch(location, sink, options);
     } catch (...) {
         sink->error();
     }
+    return {};
 }
 
 } // namespace http
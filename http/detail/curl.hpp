@@ -32,6 +32,8 @@
 #include <string>
 #include <atomic>
 #include <thread>
+#include <mutex>
+#include <array>
 
 #include <boost/noncopyable.hpp>
 #include <boost/optional.hpp>
@@ -47,6 +49,11 @@
 #include "../constants.hpp"
 #include "../sink.hpp"
 #include "../contentfetcher.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "dnscache.hpp"
+#include "latency.hpp"
+#include "scheduler.hpp"
 
 namespace http { namespace detail {
 
@@ -58,40 +65,123 @@ typedef asio::ip::tcp tcp;
 
 class CurlClient;
 
+/** CURL share handle: caches shared by easy handles of all clients (i.e. all
+ *  client threads). Access is serialized by per-data-type mutexes.
+ *
+ *  Connection cache is not shared: CURL does not support sharing
+ *  connections between concurrently running multi handles.
+ */
+class CurlShare : boost::noncopyable {
+public:
+    typedef std::shared_ptr<CurlShare> pointer;
+
+    /** Creates share handle. Returns null pointer if there is nothing to
+     *  share.
+     */
+    static pointer create(const ContentFetcher::Options *options);
+
+    CurlShare(const ContentFetcher::Options &options);
+    ~CurlShare();
+
+    ::CURLSH* handle() { return share_; }
+
+    void lock(::curl_lock_data data);
+    void unlock(::curl_lock_data data);
+
+private:
+    ::CURLSH *share_;
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> mutexes_;
+};
+
 class ClientConnection
     : boost::noncopyable
 {
 public:
     typedef std::set<ClientConnection*> set;
 
-    ClientConnection(CurlClient &owner
-                     , const std::string &location
-                     , const ClientSink::pointer &sink
-                     , const ContentFetcher::RequestOptions &options);
+    ClientConnection(CurlClient &owner);
     ~ClientConnection();
 
+    /** Prepares connection for new transfer. Easy handle is taken from
+     *  owner's pool.
+     *
+     * \param resolve pre-resolved addresses in CURLOPT_RESOLVE format
+     *                 (empty: let CURL resolve host itself)
+     */
+    void open(const Submission::pointer &submission
+              , const std::string &resolve = std::string());
+
+    /** Releases transfer resources (easy handle is returned to the pool).
+     *  Connection can be reopened.
+     */
+    void close();
+
     ::CURL* handle() { return easy_; };
 
     void notify(::CURLcode result);
 
-    void store(const char *data, std::size_t size);
+    /** Passes body data to the sink.
+     *
+     * \return size when consumed, CURL_WRITEFUNC_PAUSE to pause transfer
+     */
+    std::size_t store(const char *data, std::size_t size);
 
     void header(const char *data, std::size_t size);
 
+    const std::string& location() const { return location_; }
+
+    /** Submission of current transfer.
+     */
+    const Submission::pointer& submission() const { return submission_; }
+
+    /** Starts tracing of this transfer.
+     */
+    void trace(std::uint64_t id) {
+        traceId_ = id;
+        started_ = Tracer::Clock::now();
+    }
+
+    std::uint64_t traceId() const { return traceId_; }
+    Tracer::Clock::time_point started() const { return started_; }
+
 private:
     void processHeader();
 
+    /** Starts body delivery (once all headers are received).
+     */
+    void begin();
+
+    http::SinkBase::FileInfo fileInfo();
+
+    CurlClient &owner_;
     ::CURL *easy_;
     ::curl_slist *headers_;
+    ::curl_slist *resolve_;
     std::string location_;
-    ClientSink::pointer sink_;
+    Submission::pointer submission_;
+    StreamingClientSink::pointer sink_;
+
+    /** Body delivery state.
+     */
+    enum class Body { pending, streaming, discarded };
+    Body body_;
+
+    /** Easy handle can be returned to the pool.
+     */
+    bool reusable_;
+
+    /** Expires when connection is destroyed. Guards asynchronous resume.
+     */
+    std::shared_ptr<void> alive_;
 
     std::string headerName_;
     std::string headerValue_;
 
     std::time_t maxAge_;
     std::time_t expires_;
-    std::string content_;
+
+    std::uint64_t traceId_;
+    Tracer::Clock::time_point started_;
 };
 
 struct Socket : boost::noncopyable {
@@ -156,16 +246,46 @@ class CurlClient : boost::noncopyable {
 public:
     typedef std::shared_ptr<CurlClient> pointer;
     typedef std::vector<CurlClient::pointer> list;
-    CurlClient(int id, const ContentFetcher::Options *options = nullptr);
+    /** Creates client with its own worker thread.
+     *
+     * \param id client id (used in thread name)
+     * \param options global client options
+     * \param metrics optional metrics to update (must outlive the client)
+     * \param tracer optional tracer (must outlive the client)
+     * \param share optional caches shared with other clients
+     * \param dnsCache optional resolver cache (must outlive the client),
+     *                  CURL resolves hosts itself if not set
+     */
+    CurlClient(int id, const ContentFetcher::Options *options = nullptr
+               , Metrics *metrics = nullptr, Tracer *tracer = nullptr
+               , const CurlShare::pointer &share = CurlShare::pointer()
+               , DnsCache *dnsCache = nullptr);
     ~CurlClient();
 
-    void fetch(const std::string &location
-               , const ClientSink::pointer &sink
-               , const ContentFetcher::RequestOptions &options);
+    /** Submits request. Thread-safe and lock-free: immediate requests are
+     *  pushed to the submission queue which is drained in batches by the
+     *  client's worker.
+     *
+     * \return request cancel function
+     */
+    ContentFetcher::Cancel fetch(const std::string &location
+                                 , const ClientSink::pointer &sink
+                                 , const ContentFetcher::RequestOptions
+                                 &options);
 
     void add(std::unique_ptr<ClientConnection> &&conn);
     void remove(ClientConnection *conn);
 
+    /** Returns easy handle from the pool or new handle with default options
+     *  set.
+     */
+    ::CURL* easy();
+
+    /** Returns easy handle to the pool. Handle is destroyed if not reusable
+     *  (i.e. its transfer did not finish cleanly) or pool is full.
+     */
+    void release(::CURL *easy, bool reusable);
+
     int handle_cb(::CURL *easy, ::curl_socket_t s, int what
                   , void *socketp);
 
@@ -176,6 +296,46 @@ public:
 
     int close_cb(::curl_socket_t s);
 
+    asio::io_service& ioService() { return ios_; }
+
+    /** Number of handlers executed by client's worker.
+     */
+    std::uint64_t handlers() const { return handlers_; }
+
+    /** Number of requests submitted to this client and not finished yet.
+     */
+    std::size_t load() const { return load_; }
+
+    /** Link between callbacks handed out to users (cancel, resume) and live
+     *  client: client is detached (under mutex) before it is destroyed,
+     *  callbacks can outlive it.
+     */
+    struct Link {
+        std::mutex mutex;
+        CurlClient *client;
+
+        Link(CurlClient *client) : client(client) {}
+
+        /** Posts handler to client's worker if client is still alive,
+         *  handler is called with the client.
+         */
+        template <typename Handler> void post(const Handler &handler);
+    };
+
+    /** Returns link to this client.
+     */
+    std::weak_ptr<Link> link() const { return link_; }
+
+    enum class Family { ipv4, ipv6 };
+    enum : unsigned { familyCount = 2 };
+
+    /** TCP connect latency (microseconds) of new connections over given
+     *  address family.
+     */
+    const Histogram& connectLatency(Family family) const {
+        return connectLatency_[static_cast<unsigned>(family)];
+    }
+
 private:
     void start(unsigned int id);
     void stop();
@@ -183,22 +343,109 @@ private:
 
     void action(::curl_socket_t socket = CURL_SOCKET_TIMEOUT, int what = 0);
 
+    /** Adds all queued submissions to the multi handle.
+     */
+    void drain();
+
+    /** Passes submission through the scheduler.
+     */
+    void submit(const Submission::pointer &submission);
+
+    /** Resolves submission's host (if there is DNS cache) and adds it to
+     *  the multi handle.
+     */
+    void launch(const Submission::pointer &submission);
+
+    /** Finishes submission: releases its load and scheduler slot.
+     */
+    void done(Submission &submission);
+
+    /** Cancels submission in any state. Sink is notified unless submission
+     *  is already finished.
+     */
+    void cancel(const Submission::pointer &submission);
+
+    void resolved(const Submission::pointer &submission
+                  , const std::string &host
+                  , const std::string &service
+                  , const bs::error_code &ec
+                  , const DnsCache::EndpointsPointer &endpoints);
+
+    /** Returns connection from the freelist (or a new one) prepared for
+     *  given transfer.
+     */
+    std::unique_ptr<ClientConnection>
+    connection(const Submission::pointer &submission
+               , const std::string &resolve = std::string());
+
     void prepareRead(Socket *socket);
     void prepareWrite(Socket *socket);
 
+    /** Records connect latency of finished transfer if it has opened new
+     *  connection.
+     */
+    void connected(::CURL *easy);
+
+    void count(Metrics::Counter counter, std::uint64_t value = 1) {
+        if (metrics_) { metrics_->add(counter, value); }
+    }
+
+    Metrics *metrics_;
+    Tracer *tracer_;
+    std::shared_ptr<Link> link_;
+    long happyEyeballsTimeout_;
+    Histogram connectLatency_[familyCount];
+
+    /** Kept alive until all our easy handles are destroyed.
+     */
+    CurlShare::pointer share_;
+    DnsCache *dnsCache_;
     ::CURLM *multi_;
     asio::io_service ios_;
     boost::optional<asio::io_service::work> work_;
     std::thread worker_;
+    std::atomic<std::uint64_t> handlers_;
+    std::atomic<std::size_t> load_;
+    Scheduler scheduler_;
+
+    /** Multiple-producer single-consumer submission queue: lock-free stack
+     *  of pending submissions, newest first. Worker takes whole stack at
+     *  once. Worker is woken up only by push to an empty stack.
+     */
+    std::atomic<Submission*> submissions_;
     asio::deadline_timer timer_;
 
     struct HandleIdx {};
 
     ClientConnection::set connections_;
+
+    /** Maximum number of idle easy handles and connections kept for reuse.
+     */
+    static constexpr std::size_t maxPooled = 256;
+
+    /** Idle easy handles with default options set.
+     */
+    std::vector<::CURL*> easyPool_;
+
+    /** Idle connections.
+     */
+    std::vector<std::unique_ptr<ClientConnection>> freeConnections_;
     Socket::map sockets_;
     int runningTransfers_;
 };
 
+// inlines
+
+template <typename Handler>
+void CurlClient::Link::post(const Handler &handler)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!client) { return; }
+
+    auto *c(client);
+    client->ios_.post([c, handler]() { handler(*c); });
+}
+
 } } // namespace http::detail
 
 #endif // http_detail_curl_hpp_included_
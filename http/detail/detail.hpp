@@ -44,6 +44,12 @@
 #include "../contentfetcher.hpp"
 #include "dnscache.hpp"
 #include "curl.hpp"
+#include "dispatcher.hpp"
+#include "accesslog.hpp"
+#include "latency.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "loopmonitor.hpp"
 
 namespace http {
 
@@ -93,6 +99,9 @@ public:
     listen(const utility::TcpEndpoint &listen
            , const ContentGenerator::pointer &contentGenerator);
 
+    MemoryStream::pointer
+    connect(const ContentGenerator::pointer &contentGenerator);
+
     static Detail& detail(const Http &http) { return *http.detail_; }
 
     asio::io_service& ioService() { return ios_; }
@@ -103,40 +112,85 @@ public:
 
     const std::string& serverHeader() const { return serverHeader_; }
 
+    void batchPath(const std::string &value) { batchPath_ = value; }
+
+    void serverTiming(bool value) { serverTiming_ = value; }
+
+    bool serverTiming() const { return serverTiming_; }
+
+    void slowRequestThreshold(long value) { slowRequestThreshold_ = value; }
+
+    long slowRequestThreshold() const { return slowRequestThreshold_; }
+
+    void accessLog(const std::string &path, std::size_t capacity);
+
+    detail::AccessLog* accessLog() const { return accessLog_.get(); }
+
+    void latencyRoutes(const std::vector<std::string> &prefixes);
+
+    detail::LatencyStats& latency() { return latency_; }
+
+    detail::Metrics& metrics() { return metrics_; }
+
+    /** Prints statistics in Prometheus text exposition format.
+     */
+    void metrics(std::ostream &os) const;
+
+    detail::Tracer& tracer() { return tracer_; }
+    const detail::Tracer& tracer() const { return tracer_; }
+
     void request() { requestCounter_.event(); }
 
+    void loopMonitor(long interval);
+
     void stat(std::ostream &os) const;
 
 private:
-    virtual void fetch_impl(const std::string &location
-                            , const ClientSink::pointer &sink
-                            , const RequestOptions &options);
+    /** Connect latencies of all clients merged.
+     */
+    detail::Histogram::Snapshot
+    connectLatency(detail::CurlClient::Family family) const;
+
+    virtual Cancel fetch_impl(const std::string &location
+                              , const ClientSink::pointer &sink
+                              , const RequestOptions &options);
 
     void worker(std::size_t id);
 
+    detail::Metrics metrics_;
+    detail::Tracer tracer_;
+    detail::LoopMonitor loopMonitor_;
+
     asio::io_service ios_;
     boost::optional<asio::io_service::work> work_;
     detail::DnsCache dnsCache_;
     std::vector<std::thread> workers_;
 
+    /** Number of handlers executed by each worker.
+     */
+    std::unique_ptr<std::atomic<std::uint64_t>[]> handlers_;
+
     std::vector<std::shared_ptr<detail::Acceptor>> acceptors_;
     std::set<std::shared_ptr<detail::ServerConnection>> connections_;
     std::mutex connMutex_;
     std::condition_variable connCond_;
     std::atomic<bool> running_;
     std::string serverHeader_;
+    std::string batchPath_;
+    std::atomic<bool> serverTiming_;
+    std::atomic<long> slowRequestThreshold_;
+    std::unique_ptr<detail::AccessLog> accessLog_;
+    detail::LatencyStats latency_;
     utility::EventCounter connectionCounter_;
     utility::EventCounter requestCounter_;
 
-    std::mutex clientMutex_;
-
-    /** CURL based clients.
-     */
-    detail::CurlClient::list clients_;
+    mutable std::mutex clientMutex_;
 
-    /** Current client. Workload is distributed in round-robin manner.
+    /** CURL based clients. Null when client-side machinery is not running.
+     *  Accessed via std::atomic_load/store (fetch takes no lock); swapped
+     *  only under clientMutex_.
      */
-    detail::CurlClient::list::iterator currentClient_;
+    detail::Dispatcher::pointer dispatcher_;
 };
 
 } // namespace http
@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+
+#include <boost/functional/hash.hpp>
+
+#include "dispatcher.hpp"
+
+namespace http { namespace detail {
+
+namespace {
+
+/** SplitMix64 finalizer.
+ */
+inline std::uint64_t mix(std::uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/** Hashes scheme and authority (without user info) of given URL.
+ */
+std::uint64_t hostHash(const std::string &location)
+{
+    const auto b(location.begin());
+
+    // scheme
+    const auto scheme(location.find("://"));
+    const auto start((scheme == std::string::npos) ? 0 : scheme + 3);
+
+    // authority
+    auto end(location.find_first_of("/?#", start));
+    if (end == std::string::npos) { end = location.size(); }
+
+    // skip user info
+    const auto at(location.rfind('@', end));
+    const auto host(((at == std::string::npos) || (at < start))
+                    ? start : at + 1);
+
+    std::size_t seed(boost::hash_range(b, b + start));
+    boost::hash_range(seed, b + host, b + end);
+    return seed;
+}
+
+} // namespace
+
+Dispatcher::Dispatcher(const CurlClient::list &clients
+                       , const ContentFetcher::Options *options
+                       , Metrics *metrics)
+    : clients_(clients)
+    , hostAffinity_(options ? options->hostAffinity : true)
+    , maxLoad_(std::max(options ? options->hostAffinityMaxLoad : 1.25, 1.0))
+    , metrics_(metrics), next_(0)
+{
+    seeds_.reserve(clients_.size());
+    for (std::size_t i(0), e(clients_.size()); i < e; ++i) {
+        seeds_.push_back(mix(i));
+    }
+}
+
+CurlClient& Dispatcher::client(const std::string &location)
+{
+    if (hostAffinity_ && (clients_.size() > 1)) {
+        return affine(location);
+    }
+
+    return *clients_[next_++ % clients_.size()];
+}
+
+CurlClient& Dispatcher::affine(const std::string &location)
+{
+    const auto hash(hostHash(location));
+    const auto size(clients_.size());
+
+    // highest random weight wins
+    std::size_t best(0);
+    std::uint64_t bestScore(0);
+    std::size_t total(0);
+    for (std::size_t i(0); i < size; ++i) {
+        const auto score(mix(hash ^ seeds_[i]));
+        if (score >= bestScore) {
+            best = i;
+            bestScore = score;
+        }
+        total += clients_[i]->load();
+    }
+
+    // bounded load: least loaded client is always below capacity
+    const auto capacity(maxLoad_ * (total + 1) / size);
+    if (clients_[best]->load() < capacity) { return *clients_[best]; }
+
+    // spill over to the next client in host's ranking that has room
+    std::size_t next(best);
+    std::uint64_t nextScore(0);
+    bool found(false);
+    for (std::size_t i(0); i < size; ++i) {
+        if (i == best) { continue; }
+        if (clients_[i]->load() >= capacity) { continue; }
+        const auto score(mix(hash ^ seeds_[i]));
+        if (!found || (score >= nextScore)) {
+            next = i;
+            nextScore = score;
+            found = true;
+        }
+    }
+
+    if (metrics_ && (next != best)) {
+        metrics_->add(Metrics::Counter::clientDispatchSpillovers);
+    }
+    return *clients_[next];
+}
+
+} } // namespace http::detail
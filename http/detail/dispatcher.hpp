@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef http_detail_dispatcher_hpp_included_
+#define http_detail_dispatcher_hpp_included_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "../contentfetcher.hpp"
+#include "curl.hpp"
+#include "metrics.hpp"
+
+namespace http { namespace detail {
+
+/** Distributes client requests between CURL clients.
+ *
+ *  With host affinity, requests to the same host are sent to the same client
+ *  (rendezvous hashing of scheme://host:port) so they can reuse its
+ *  keep-alive and HTTP/2 connections. When host's preferred client is
+ *  overloaded (its load exceeds configured multiple of average load) request
+ *  spills over to the next client in host's ranking (consistent hashing with
+ *  bounded loads).
+ *
+ *  Without host affinity requests are distributed in round-robin manner.
+ *
+ *  Client list is fixed for dispatcher's lifetime.
+ */
+class Dispatcher : boost::noncopyable {
+public:
+    typedef std::shared_ptr<Dispatcher> pointer;
+
+    /**
+     * \param clients clients to distribute requests to (non-empty)
+     * \param options global client options
+     * \param metrics optional metrics to update (must outlive dispatcher)
+     */
+    Dispatcher(const CurlClient::list &clients
+               , const ContentFetcher::Options *options = nullptr
+               , Metrics *metrics = nullptr);
+
+    /** Picks client for request to given location.
+     */
+    CurlClient& client(const std::string &location);
+
+    const CurlClient::list& clients() const { return clients_; }
+
+private:
+    CurlClient& affine(const std::string &location);
+
+    const CurlClient::list clients_;
+    const bool hostAffinity_;
+    const double maxLoad_;
+    Metrics *metrics_;
+
+    /** Per-client rendezvous hashing seeds.
+     */
+    std::vector<std::uint64_t> seeds_;
+
+    std::atomic<std::size_t> next_;
+};
+
+} } // namespace http::detail
+
+#endif // http_detail_dispatcher_hpp_included_
@@ -0,0 +1,195 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <tuple>
+
+#include "dbglog/dbglog.hpp"
+
+#include "dnscache.hpp"
+
+namespace http { namespace detail {
+
+namespace asio = boost::asio;
+namespace bs = boost::system;
+typedef asio::ip::tcp tcp;
+
+DnsCache::DnsCache()
+    : ttl_(Clock::duration(std::chrono::seconds(60)).count())
+    , negativeTtl_(Clock::duration(std::chrono::seconds(5)).count())
+    , hits_(0), misses_(0), refreshes_(0)
+{}
+
+void DnsCache::ttl(Clock::duration positive, Clock::duration negative)
+{
+    ttl_ = positive.count();
+    negativeTtl_ = negative.count();
+}
+
+DnsCache::Shard& DnsCache::shard(const std::string &key)
+{
+    return shards_[std::hash<std::string>()(key) % shardCount];
+}
+
+void DnsCache::sweep(Shard &s, Clock::time_point now)
+{
+    if (now < s.sweep) { return; }
+    s.sweep = now + std::chrono::seconds(1);
+
+    for (auto ientries(s.entries.begin()); ientries != s.entries.end(); ) {
+        const auto &entry(ientries->second);
+        if (!entry.lookup && entry.waiters.empty()
+            && (now >= entry.expires))
+        {
+            ientries = s.entries.erase(ientries);
+        } else {
+            ++ientries;
+        }
+    }
+}
+
+std::size_t DnsCache::size() const
+{
+    std::size_t size(0);
+    for (auto &s : shards_) {
+        std::unique_lock<std::mutex> lock(s.mutex);
+        size += s.entries.size();
+    }
+    return size;
+}
+
+void DnsCache::lookup(asio::io_service &ios, const std::string &key
+                      , const std::string &host, const std::string &service)
+{
+    try {
+        auto resolver(std::make_shared<tcp::resolver>(ios));
+        resolver->async_resolve
+            (tcp::resolver::query(host, service)
+             , [this, &ios, resolver, key](const bs::error_code &ec
+                                           , tcp::resolver::iterator i)
+        {
+            // io_service is going down, state is cleaned up by forget()
+            if (ec == asio::error::operation_aborted) { return; }
+
+            if (ec) {
+                LOG(warn2) << "Failed to resolve <" << key << ">: "
+                           << ec.message() << ".";
+                return finish(ios, key, ec, {});
+            }
+
+            auto endpoints(std::make_shared<Endpoints>());
+            for (tcp::resolver::iterator e; i != e; ++i) {
+                endpoints->push_back(i->endpoint());
+            }
+
+            if (endpoints->empty()) {
+                return finish(ios, key, asio::error::host_not_found, {});
+            }
+            finish(ios, key, ec, endpoints);
+        });
+    } catch (const std::exception &e) {
+        LOG(err2) << "Failed to start lookup of <" << key << ">: "
+                  << e.what() << ".";
+        finish(ios, key, asio::error::no_recovery, {});
+    }
+}
+
+void DnsCache::finish(asio::io_service &ios, const std::string &key
+                      , const bs::error_code &ec
+                      , EndpointsPointer endpoints)
+{
+    auto &s(shard(key));
+    const auto now(Clock::now());
+
+    std::unique_lock<std::mutex> lock(s.mutex);
+    auto fentries(s.entries.find(key));
+    if (fentries == s.entries.end()) { return; }
+    auto &entry(fentries->second);
+
+    // lookup has been taken over by another io_service
+    if (entry.lookup != &ios) { return; }
+    entry.lookup = nullptr;
+
+    if (ec && entry.endpoints && (now < entry.expires)) {
+        // failed refresh: serve old result until it expires
+    } else {
+        entry.endpoints = endpoints;
+        entry.ec = ec;
+
+        const Clock::duration ttl(ec ? negativeTtl_.load() : ttl_.load());
+        entry.expires = now + ttl;
+        entry.refresh = ec ? entry.expires : (now + (ttl * 3) / 4);
+    }
+
+    // notify waiters; posting under lock, forget() must not find any
+    // waiter already taken and not yet posted
+    for (auto &waiter : entry.waiters) {
+        waiter.ios->post(std::bind(waiter.handler, entry.ec
+                                   , entry.endpoints));
+    }
+    entry.waiters.clear();
+
+    // NB: invalidates entry
+    sweep(s, now);
+}
+
+void DnsCache::forget(asio::io_service &ios)
+{
+    for (auto &s : shards_) {
+        // lookups orphaned by given io_service that other callers still
+        // wait for
+        std::vector<std::tuple<asio::io_service*, std::string, std::string
+                               , std::string>> restart;
+        {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            for (auto &item : s.entries) {
+                auto &entry(item.second);
+                auto &waiters(entry.waiters);
+                waiters.erase(std::remove_if
+                              (waiters.begin(), waiters.end()
+                               , [&](const Waiter &w) {
+                                   return w.ios == &ios;
+                               })
+                              , waiters.end());
+
+                if (entry.lookup != &ios) { continue; }
+                entry.lookup = nullptr;
+
+                if (!waiters.empty()) {
+                    entry.lookup = waiters.front().ios;
+                    restart.emplace_back(entry.lookup, item.first
+                                         , entry.host, entry.service);
+                }
+            }
+        }
+
+        for (const auto &r : restart) {
+            lookup(*std::get<0>(r), std::get<1>(r), std::get<2>(r)
+                   , std::get<3>(r));
+        }
+    }
+}
+
+} } // namespace http::detail
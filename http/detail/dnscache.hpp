@@ -26,112 +26,208 @@
 #ifndef http_detail_dnscache_hpp_included_
 #define http_detail_dnscache_hpp_included_
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
-#include <mutex>
 
+#include <boost/noncopyable.hpp>
 #include <boost/asio.hpp>
-#include <boost/format.hpp>
-
-#include "dbglog/dbglog.hpp"
-#include "utility/uri.hpp"
 
 namespace http { namespace detail {
 
-class DnsCache {
+/** Asynchronous DNS cache.
+ *
+ *  Results (including failures) are cached for configured time-to-live.
+ *  Concurrent lookups of the same host:service are coalesced into single
+ *  resolver call. Entry that is used during last quarter of its lifetime is
+ *  refreshed in the background while old result is still being served.
+ *  Expired entries nobody waits for are swept out periodically (on lookup
+ *  of a new key or lookup completion) so cache size is bounded by the
+ *  number of distinct keys used within their lifetime.
+ *
+ *  Lookups run on resolver bound to io_service of the caller that started
+ *  them; result handlers are posted to io_service of each waiting caller.
+ *  Every io_service must be unregistered by forget() before it is destroyed.
+ */
+class DnsCache : boost::noncopyable {
 public:
-    DnsCache(boost::asio::io_service &ios)
-        : ios_(ios), resolver_(ios)
-    {}
+    typedef std::chrono::steady_clock Clock;
+    typedef std::vector<boost::asio::ip::tcp::endpoint> Endpoints;
+
+    /** Resolved endpoints, null on error.
+     */
+    typedef std::shared_ptr<const Endpoints> EndpointsPointer;
+
+    typedef std::function<void(const boost::system::error_code&
+                               , const EndpointsPointer&)> Handler;
+
+    DnsCache();
+
+    /** Sets lifetime of successful and failed lookups.
+     */
+    void ttl(Clock::duration positive, Clock::duration negative);
 
+    /** Resolves host:service.
+     *
+     *  Valid cached result is passed to the handler right away (i.e. handler
+     *  is called from inside this function). Otherwise handler is posted to
+     *  ios once lookup finishes.
+     */
     template <typename ResolveHandler>
-    void resolve(const utility::Uri &uri, const ResolveHandler &rh);
+    void resolve(boost::asio::io_service &ios, const std::string &host
+                 , const std::string &service, ResolveHandler &&rh);
 
-    typedef std::vector<boost::asio::ip::tcp::endpoint> Endpoints;
+    /** Drops all waiting handlers and running lookups bound to given
+     *  io_service. Must be called before ios is destroyed.
+     */
+    void forget(boost::asio::io_service &ios);
 
-private:
-    boost::asio::io_service &ios_;
-    boost::asio::ip::tcp::resolver resolver_;
+    std::uint64_t hits() const { return hits_; }
+    std::uint64_t misses() const { return misses_; }
+    std::uint64_t refreshes() const { return refreshes_; }
+
+    /** Number of cached entries (including expired ones not swept yet).
+     */
+    std::size_t size() const;
 
-    std::mutex mutex_;
+private:
+    struct Waiter {
+        boost::asio::io_service *ios;
+        Handler handler;
+    };
 
     struct Entry {
-        Endpoints endpoints;
-        std::time_t expires;
+        /** Last result.
+         */
+        EndpointsPointer endpoints;
+        boost::system::error_code ec;
+
+        /** Result is valid until expires. Background refresh is started by
+         *  first hit after refresh.
+         */
+        Clock::time_point expires;
+        Clock::time_point refresh;
+
+        /** io_service running current lookup, null if none
+         */
+        boost::asio::io_service *lookup;
+
+        std::vector<Waiter> waiters;
+
+        std::string host;
+        std::string service;
+
+        Entry() : lookup() {}
+
+        typedef std::unordered_map<std::string, Entry> map;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        Entry::map entries;
 
-        typedef std::map<std::string, Entry> map;
+        /** Time of next sweep of expired entries.
+         */
+        Clock::time_point sweep;
     };
 
-    Entry::map cache_;
+    static constexpr std::size_t shardCount = 16;
+
+    Shard& shard(const std::string &key);
+
+    /** Removes expired entries with no running lookup and no waiters if it
+     *  is time to do so. Called under shard's lock.
+     */
+    void sweep(Shard &s, Clock::time_point now);
+
+    /** Starts lookup. Called outside of any lock.
+     */
+    void lookup(boost::asio::io_service &ios, const std::string &key
+                , const std::string &host, const std::string &service);
+
+    /** Stores result and notifies waiters.
+     */
+    void finish(boost::asio::io_service &ios, const std::string &key
+                , const boost::system::error_code &ec
+                , EndpointsPointer endpoints);
+
+    std::atomic<Clock::duration::rep> ttl_;
+    std::atomic<Clock::duration::rep> negativeTtl_;
+
+    mutable std::array<Shard, shardCount> shards_;
+
+    std::atomic<std::uint64_t> hits_;
+    std::atomic<std::uint64_t> misses_;
+    std::atomic<std::uint64_t> refreshes_;
 };
 
+// inlines
+
 template <typename ResolveHandler>
-void DnsCache::resolve(const utility::Uri &uri, const ResolveHandler &rh)
+void DnsCache::resolve(boost::asio::io_service &ios, const std::string &host
+                       , const std::string &service, ResolveHandler &&rh)
 {
-    const auto key((uri.port() <= 0)
-                   ? uri.host()
-                   : str(boost::format("%s:%d") % uri.host() % uri.port()));
-
-    Endpoints endpoints;
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-
-        auto fcache(cache_.find(key));
-        if (fcache != cache_.end()) {
-            // something cached
-            if (fcache->second.expires >= std::time(nullptr)) {
-                // still valid
-                endpoints = fcache->second.endpoints;
-            }
-        }
-    }
+    auto key(host);
+    key.push_back(':');
+    key.append(service);
 
-    // call callback outside of any lock
-    if (!endpoints.empty()) {
-        ios_.post([=]() {
-                rh(boost::system::error_code(), endpoints);
-            });
-        return;
-    }
+    auto &s(shard(key));
+    const auto now(Clock::now());
 
-    // not cached
-    // resolve hostname
-    resolver_.async_resolve
-        (boost::asio::ip::tcp::resolver::query
-         (uri.host(), uri.scheme())
-         , [rh, key, this](const boost::system::error_code &ec
-                           , boost::asio::ip::tcp::resolver::iterator i)
-          mutable
+    EndpointsPointer endpoints;
+    boost::system::error_code ec;
+    bool start(false);
     {
-        if (ec) {
-            rh(ec, Endpoints());
-            return;
+        std::unique_lock<std::mutex> lock(s.mutex);
+        auto fentries(s.entries.find(key));
+        if (fentries == s.entries.end()) {
+            // new key: make room first
+            sweep(s, now);
+            fentries = s.entries.insert
+                (Entry::map::value_type(key, Entry())).first;
+            fentries->second.host = host;
+            fentries->second.service = service;
         }
+        auto &entry(fentries->second);
+
+        if (now >= entry.expires) {
+            // nothing valid cached: wait for (possibly running) lookup
+            ++misses_;
+            entry.waiters.push_back({ &ios, std::forward<ResolveHandler>(rh) });
+            if (!entry.lookup) {
+                entry.lookup = &ios;
+                start = true;
+            }
+            lock.unlock();
 
-        Entry entry;
-        entry.expires = std::time(nullptr) + 300;
-        for (boost::asio::ip::tcp::resolver::iterator e; i != e; ++i) {
-            entry.endpoints.push_back(i->endpoint());
+            if (start) { lookup(ios, key, host, service); }
+            return;
         }
 
-        // cache
-        {
-            std::unique_lock<std::mutex> lock(mutex_);
+        // valid result
+        ++hits_;
+        endpoints = entry.endpoints;
+        ec = entry.ec;
 
-            // insert/replace
-            auto res(cache_.insert(Entry::map::value_type(key, entry)));
-            if (!res.second) {
-                res.first->second = entry;
-            }
+        if (endpoints && !entry.lookup && (now >= entry.refresh)) {
+            // hot entry about to expire, refresh in the background
+            ++refreshes_;
+            entry.lookup = &ios;
+            start = true;
         }
+    }
+
+    if (start) { lookup(ios, key, host, service); }
 
-        // and callback
-        ios_.post([=]() {
-                rh(ec, entry.endpoints);
-            });
-        return;
-    });
+    // call handler outside of any lock
+    rh(ec, endpoints);
 }
 
 } } // namespace http::detail
@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdio>
+#include <sstream>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "../constants.hpp"
+
+#include "headers.hpp"
+
+namespace ba = boost::algorithm;
+
+namespace http { namespace detail {
+
+void writeResponseHeader(std::ostream &os, const std::string &version
+                         , const Response &response
+                         , const std::string &server)
+{
+    os << version << ' ' << response.numericCode() << ' '
+       << utility::httpCodeCategory().message(response.numericCode())
+       << "\r\n";
+
+    os << "Date: " << formatHttpDate(-1) << "\r\n";
+    os << "Server: " << server << "\r\n";
+
+    for (const auto &hdr : response.headers) {
+        os << hdr.name << ": "  << hdr.value << "\r\n";
+    }
+}
+
+std::string chunkHeader(std::size_t size)
+{
+    char buf[24];
+    const auto len(std::snprintf(buf, sizeof(buf), "%zx\r\n", size));
+    return std::string(buf, len);
+}
+
+std::time_t parseCacheControl(const std::string &value)
+{
+    std::string token;
+    std::time_t ma(constants::cacheUnspecified);
+    std::time_t sma(constants::cacheUnspecified);
+    bool noCache(false);
+    bool private_(false);
+    bool public_(false);
+    bool mustRevalidate(false);
+
+    // process value (no exception, relaxed parsing)
+    std::istringstream is(value);
+    while (is >> token) {
+        if (ba::istarts_with(token, "private")) {
+            private_ = true;
+        } else if (ba::istarts_with(token, "public")) {
+            public_ = true;
+        } else if (ba::istarts_with(token, "no-cache")) {
+            noCache = true;
+            break;
+        } else if (ba::istarts_with(token, "s-maxage=")) {
+            std::istringstream t(token);
+            t.ignore(9);
+            t >> sma;
+        } else if (ba::istarts_with(token, "max-age=")) {
+            std::istringstream t(token);
+            t.ignore(8);
+            t >> ma;
+        } else if (ba::istarts_with(token, "must-revalidate")) {
+            mustRevalidate = true;
+        }
+    }
+
+    // what to do with public?
+    (void) public_;
+
+    if (private_) {
+        // private -> we cannot cache it
+        return 0;
+    } else if (noCache) {
+        // cache forbidden
+        return 0;
+    } else if (mustRevalidate) {
+        return constants::mustRevalidate;
+    } else if (sma >= 0) {
+        return sma;
+    } else if (ma >= 0) {
+        return ma;
+    }
+
+    // have no idea
+    return constants::cacheUnspecified;
+}
+
+} } // namespace http::detail
@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef http_detail_headers_hpp_included_
+#define http_detail_headers_hpp_included_
+
+#include <ctime>
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+#include "types.hpp"
+
+namespace http { namespace detail {
+
+/** Writes response status line and common headers (Date, Server, and
+ *  response's own headers). Terminating empty line is not written.
+ */
+void writeResponseHeader(std::ostream &os, const std::string &version
+                         , const Response &response
+                         , const std::string &server);
+
+/** Returns chunk header (hexadecimal size followed by CRLF) for chunked
+ *  transfer encoding.
+ */
+std::string chunkHeader(std::size_t size);
+
+/** Parses Cache-Control header value (relaxed, never throws).
+ *
+ * \return max age in seconds, constants::mustRevalidate or
+ *         constants::cacheUnspecified
+ */
+std::time_t parseCacheControl(const std::string &value);
+
+} } // namespace http::detail
+
+#endif // http_detail_headers_hpp_included_
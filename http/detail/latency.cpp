@@ -0,0 +1,275 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include "latency.hpp"
+
+namespace http { namespace detail {
+
+namespace {
+
+inline unsigned msb(std::uint64_t value)
+{
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#else
+    unsigned res(0);
+    while (value >>= 1) { ++res; }
+    return res;
+#endif
+}
+
+const char *stageNames[LatencyStats::stageCount] = {
+    "parse", "generate", "ttfb", "write"
+};
+
+const char *classNames[LatencyStats::classCount] = {
+    "1xx", "2xx", "3xx", "4xx", "5xx"
+};
+
+} // namespace
+
+Histogram::Histogram()
+    : sum_(0), max_(0)
+{
+    for (auto &count : counts_) { count.store(0, std::memory_order_relaxed); }
+}
+
+unsigned Histogram::bucket(std::uint64_t value)
+{
+    if (value < subCount) { return unsigned(value); }
+    value = std::min(value, (std::uint64_t(1) << maxBits) - 1);
+    const auto bits(msb(value));
+    return ((bits - subBits + 1) << subBits)
+        + unsigned((value >> (bits - subBits)) & (subCount - 1));
+}
+
+std::uint64_t Histogram::highest(unsigned bucket)
+{
+    if (bucket < subCount) { return bucket; }
+    const auto shift((bucket >> subBits) - 1);
+    const auto sub(bucket & (subCount - 1));
+    return ((std::uint64_t(subCount + sub + 1)) << shift) - 1;
+}
+
+void Histogram::record(std::uint64_t value)
+{
+    // single writer: no need for read-modify-write
+    auto &count(counts_[bucket(value)]);
+    count.store(count.load(std::memory_order_relaxed) + 1
+                , std::memory_order_relaxed);
+    sum_.store(sum_.load(std::memory_order_relaxed) + value
+               , std::memory_order_relaxed);
+    if (value > max_.load(std::memory_order_relaxed)) {
+        max_.store(value, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::Snapshot::add(const Histogram &histogram)
+{
+    for (unsigned i(0); i < bucketCount; ++i) {
+        const auto count(histogram.counts_[i].load
+                         (std::memory_order_relaxed));
+        counts[i] += count;
+        total += count;
+    }
+    sum += histogram.sum_.load(std::memory_order_relaxed);
+    max = std::max(max, histogram.max_.load(std::memory_order_relaxed));
+}
+
+std::uint64_t Histogram::Snapshot::quantile(double q) const
+{
+    if (!total) { return 0; }
+
+    const auto limit(std::max<std::uint64_t>(1, std::uint64_t(q * total)));
+    std::uint64_t sum(0);
+    for (unsigned i(0); i < bucketCount; ++i) {
+        sum += counts[i];
+        if (sum >= limit) { return std::min(highest(i), max); }
+    }
+    return max;
+}
+
+struct LatencyStats::Shard {
+    /** Histograms indexed by [route][stage][status class].
+     */
+    std::unique_ptr<Histogram[]> histograms;
+
+    Shard(std::size_t routes)
+        : histograms(new Histogram[routes * stageCount * classCount])
+    {}
+
+    Histogram& get(unsigned route, unsigned stage, unsigned cls) {
+        return histograms[(route * stageCount + stage) * classCount + cls];
+    }
+};
+
+namespace {
+
+/** Thread's bound histograms.
+ */
+thread_local const LatencyStats *tlsOwner(nullptr);
+thread_local void *tlsShard(nullptr);
+
+} // namespace
+
+LatencyStats::LatencyStats()
+    : shared_(new Shard(1))
+{}
+
+LatencyStats::~LatencyStats()
+{
+    if (tlsOwner == this) { tlsOwner = nullptr; }
+}
+
+void LatencyStats::routes(const std::vector<std::string> &prefixes)
+{
+    prefixes_ = prefixes;
+    shared_.reset(new Shard(prefixes_.size() + 1));
+    for (auto &shard : shards_) {
+        shard.reset(new Shard(prefixes_.size() + 1));
+    }
+}
+
+void LatencyStats::workers(std::size_t count)
+{
+    shards_.clear();
+    for (std::size_t i(0); i < count; ++i) {
+        shards_.emplace_back(new Shard(prefixes_.size() + 1));
+    }
+}
+
+void LatencyStats::bind(std::size_t worker)
+{
+    tlsOwner = this;
+    tlsShard = shards_.at(worker).get();
+}
+
+unsigned LatencyStats::route(const std::string &path) const
+{
+    // longest matching prefix, 0 means no route
+    unsigned res(0);
+    std::size_t size(0);
+    for (unsigned i(0), e(prefixes_.size()); i < e; ++i) {
+        const auto &prefix(prefixes_[i]);
+        if ((prefix.size() >= size)
+            && !path.compare(0, prefix.size(), prefix))
+        {
+            res = i + 1;
+            size = prefix.size();
+        }
+    }
+    return res;
+}
+
+void LatencyStats::record(const std::string &path, int status
+                          , const Sample &sample)
+{
+    const auto r(route(path));
+    const auto cls(unsigned(std::min(std::max(status / 100, 1), 5) - 1));
+
+    const auto recordTo([&](Shard &shard)
+    {
+        for (unsigned stage(0); stage < stageCount; ++stage) {
+            shard.get(0, stage, cls).record(sample.stages[stage]);
+            if (r) { shard.get(r, stage, cls).record(sample.stages[stage]); }
+        }
+    });
+
+    if (tlsOwner == this) {
+        recordTo(*static_cast<Shard*>(tlsShard));
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(sharedMutex_);
+    recordTo(*shared_);
+}
+
+void LatencyStats::stat(std::ostream &os) const
+{
+    for (unsigned r(0), re(prefixes_.size() + 1); r < re; ++r) {
+        const std::string prefix
+            (r ? "http.route[" + prefixes_[r - 1] + "].latency."
+             : std::string("http.latency."));
+
+        for (unsigned stage(0); stage < stageCount; ++stage) {
+            for (unsigned cls(0); cls < classCount; ++cls) {
+                Histogram::Snapshot snapshot;
+                for (const auto &shard : shards_) {
+                    snapshot.add(shard->get(r, stage, cls));
+                }
+                snapshot.add(shared_->get(r, stage, cls));
+                if (!snapshot.total) { continue; }
+
+                const auto name(prefix + stageNames[stage] + '.'
+                                + classNames[cls] + '.');
+                os << name << "count=" << snapshot.total << '\n'
+                   << name << "p50=" << snapshot.quantile(0.5) << '\n'
+                   << name << "p90=" << snapshot.quantile(0.9) << '\n'
+                   << name << "p99=" << snapshot.quantile(0.99) << '\n'
+                   << name << "p999=" << snapshot.quantile(0.999) << '\n'
+                   << name << "max=" << snapshot.max << '\n';
+            }
+        }
+    }
+}
+
+void LatencyStats::prometheus(std::ostream &os) const
+{
+    os << "# HELP http_request_duration_microseconds Request processing "
+        "latency by stage.\n"
+       << "# TYPE http_request_duration_microseconds summary\n";
+
+    const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+    for (unsigned stage(0); stage < stageCount; ++stage) {
+        for (unsigned cls(0); cls < classCount; ++cls) {
+            Histogram::Snapshot snapshot;
+            for (const auto &shard : shards_) {
+                snapshot.add(shard->get(0, stage, cls));
+            }
+            snapshot.add(shared_->get(0, stage, cls));
+            if (!snapshot.total) { continue; }
+
+            const std::string labels
+                (std::string("stage=\"") + stageNames[stage]
+                 + "\",class=\"" + classNames[cls] + '"');
+
+            for (auto q : quantiles) {
+                os << "http_request_duration_microseconds{" << labels
+                   << ",quantile=\"" << q << "\"} "
+                   << snapshot.quantile(q) << '\n';
+            }
+            os << "http_request_duration_microseconds_sum{" << labels
+               << "} " << snapshot.sum << '\n'
+               << "http_request_duration_microseconds_count{" << labels
+               << "} " << snapshot.total << '\n';
+        }
+    }
+}
+
+} } // namespace http::detail
@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef http_detail_latency_hpp_included_
+#define http_detail_latency_hpp_included_
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <ostream>
+
+#include <boost/noncopyable.hpp>
+
+namespace http { namespace detail {
+
+/** Log-linear (HDR-style) latency histogram of microsecond values. Each
+ *  power of two range is split into 16 linear sub-buckets, i.e. relative
+ *  error is below 6.25%. Values above 2^36 us are clamped.
+ *
+ *  Single writer, any number of concurrent readers.
+ */
+class Histogram : boost::noncopyable {
+public:
+    enum : unsigned {
+        subBits = 4
+        , subCount = 1 << subBits
+        , maxBits = 36
+        , bucketCount = (maxBits - subBits + 1) * subCount
+    };
+
+    Histogram();
+
+    /** Records one value. Must be called by single thread at a time.
+     */
+    void record(std::uint64_t value);
+
+    /** Merged copy of histogram(s).
+     */
+    struct Snapshot {
+        std::vector<std::uint64_t> counts;
+        std::uint64_t total;
+        std::uint64_t sum;
+        std::uint64_t max;
+
+        Snapshot() : counts(bucketCount), total(), sum(), max() {}
+
+        void add(const Histogram &histogram);
+
+        /** Returns value at given quantile (0-1), i.e. highest value
+         *  equivalent to the bucket containing the quantile.
+         */
+        std::uint64_t quantile(double q) const;
+    };
+
+    static unsigned bucket(std::uint64_t value);
+
+    /** Highest value falling into given bucket.
+     */
+    static std::uint64_t highest(unsigned bucket);
+
+private:
+    std::atomic<std::uint64_t> counts_[bucketCount];
+    std::atomic<std::uint64_t> sum_;
+    std::atomic<std::uint64_t> max_;
+};
+
+/** Request latency statistics.
+ *
+ *  Latencies are recorded into per-thread histograms (one per server worker
+ *  thread) broken down by stage, status class and (optional) route
+ *  prefix. Recording is lock-free; histograms are merged only when
+ *  statistics are printed.
+ */
+class LatencyStats : boost::noncopyable {
+public:
+    enum class Stage {
+        /** Request line and headers reading. */
+        parse
+        /** Dispatch to content generator until response is started. */
+        , generate
+        /** Request reception until response is started. */
+        , ttfb
+        /** Response writing. */
+        , write
+    };
+
+    enum : unsigned { stageCount = 4, classCount = 5 };
+
+    /** Durations of one request (microseconds).
+     */
+    struct Sample {
+        std::uint64_t stages[stageCount];
+
+        std::uint64_t& operator[](Stage stage) {
+            return stages[static_cast<unsigned>(stage)];
+        }
+    };
+
+    LatencyStats();
+    ~LatencyStats();
+
+    /** Sets route prefixes. Must be called before workers are started.
+     */
+    void routes(const std::vector<std::string> &prefixes);
+
+    /** Allocates per-worker histograms. Must be called before workers are
+     *  started.
+     */
+    void workers(std::size_t count);
+
+    /** Binds calling thread to given worker's histograms.
+     */
+    void bind(std::size_t worker);
+
+    /** Records sample. Uses bound histograms when called from a worker thread,
+     *  shared (locked) histograms otherwise.
+     */
+    void record(const std::string &path, int status, const Sample &sample);
+
+    /** Prints count, p50, p90, p99, p999 and max for each non-empty
+     *  route/stage/status class combination.
+     */
+    void stat(std::ostream &os) const;
+
+    /** Prints overall latencies as Prometheus summaries.
+     */
+    void prometheus(std::ostream &os) const;
+
+private:
+    struct Shard;
+
+    unsigned route(const std::string &path) const;
+
+    std::vector<std::string> prefixes_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    /** Histograms for samples recorded outside worker threads.
+     */
+    std::unique_ptr<Shard> shared_;
+    std::mutex sharedMutex_;
+};
+
+} } // namespace http::detail
+
+#endif // http_detail_latency_hpp_included_
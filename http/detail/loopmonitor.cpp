@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <chrono>
+
+#include "dbglog/dbglog.hpp"
+
+#include "loopmonitor.hpp"
+
+namespace http { namespace detail {
+
+namespace asio = boost::asio;
+namespace bs = boost::system;
+
+struct LoopMonitor::Probe {
+    typedef std::chrono::steady_clock Clock;
+
+    std::string name;
+    asio::io_service &ios;
+
+    /** Probe has been posted and not run yet.
+     */
+    std::atomic<bool> pending;
+
+    /** Scheduling delay (microseconds).
+     */
+    Histogram lag;
+
+    Probe(const std::string &name, asio::io_service &ios)
+        : name(name), ios(ios), pending(false)
+    {}
+};
+
+LoopMonitor::LoopMonitor()
+    : interval_(100), timer_(ios_)
+{}
+
+LoopMonitor::~LoopMonitor()
+{
+    stop();
+}
+
+void LoopMonitor::add(const std::string &name, asio::io_service &ios)
+{
+    if (interval_ <= 0) { return; }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    probes_.push_back(std::make_shared<Probe>(name, ios));
+
+    if (thread_.joinable()) { return; }
+
+    // first io_service, start monitoring thread
+    ios_.reset();
+    work_.emplace(std::ref(ios_));
+    schedule();
+    thread_ = std::thread([this]()
+    {
+        dbglog::thread_id("loopmon");
+        ios_.run();
+    });
+}
+
+void LoopMonitor::stop()
+{
+    if (thread_.joinable()) {
+        ios_.post([this]()
+        {
+            bs::error_code ec;
+            timer_.cancel(ec);
+        });
+        work_ = boost::none;
+        thread_.join();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    probes_.clear();
+}
+
+void LoopMonitor::schedule()
+{
+    timer_.expires_from_now(std::chrono::milliseconds(interval_));
+    timer_.async_wait([this](const bs::error_code &ec)
+    {
+        if (ec) { return; }
+        probe();
+        schedule();
+    });
+}
+
+void LoopMonitor::probe()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const auto &p : probes_) {
+        // skip io_service with probe still waiting to be run
+        if (p->pending.exchange(true)) { continue; }
+
+        const auto posted(Probe::Clock::now());
+        auto probe(p);
+        p->ios.post([probe, posted]()
+        {
+            const auto lag(std::chrono::duration_cast
+                           <std::chrono::microseconds>
+                           (Probe::Clock::now() - posted).count());
+            probe->lag.record(lag);
+            probe->pending = false;
+        });
+    }
+}
+
+void LoopMonitor::stat(std::ostream &os) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const auto &p : probes_) {
+        Histogram::Snapshot snapshot;
+        snapshot.add(p->lag);
+
+        const auto prefix("http.loop." + p->name + ".lag.");
+        os << prefix << "probes=" << snapshot.total << '\n'
+           << prefix << "p50=" << snapshot.quantile(0.5) << '\n'
+           << prefix << "p99=" << snapshot.quantile(0.99) << '\n'
+           << prefix << "max=" << snapshot.max << '\n'
+           << prefix << "pending=" << p->pending << '\n';
+    }
+}
+
+} } // namespace http::detail
@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef http_detail_loopmonitor_hpp_included_
+#define http_detail_loopmonitor_hpp_included_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <ostream>
+
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "latency.hpp"
+
+namespace http { namespace detail {
+
+/** Event loop lag monitor.
+ *
+ *  Periodically posts a probe handler to each monitored io_service and
+ *  records the delay between posting and running the handler. Only one
+ *  probe per io_service is in flight at a time.
+ */
+class LoopMonitor : boost::noncopyable {
+public:
+    LoopMonitor();
+    ~LoopMonitor();
+
+    /** Sets probing interval in milliseconds, 0 disables probing. Must be
+     *  called before first io_service is added.
+     */
+    void interval(long value) { interval_ = value; }
+
+    /** Starts monitoring given io_service.
+     */
+    void add(const std::string &name, boost::asio::io_service &ios);
+
+    /** Stops monitoring of all io_services.
+     */
+    void stop();
+
+    /** Prints lag percentiles of all monitored io_services.
+     */
+    void stat(std::ostream &os) const;
+
+private:
+    struct Probe;
+
+    void schedule();
+    void probe();
+
+    long interval_;
+
+    boost::asio::io_service ios_;
+    boost::optional<boost::asio::io_service::work> work_;
+    boost::asio::steady_timer timer_;
+    std::thread thread_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<Probe>> probes_;
+};
+
+} } // namespace http::detail
+
+#endif // http_detail_loopmonitor_hpp_included_
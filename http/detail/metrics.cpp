@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include "metrics.hpp"
+
+namespace http { namespace detail {
+
+static_assert((static_cast<unsigned>
+               (Metrics::Counter::clientTransfersCancelled) + 1)
+              == Metrics::counterCount
+              , "Metrics::counterCount does not match counter list.");
+
+Metrics::Shard::Shard()
+{
+    for (auto &value : values) { value.store(0, std::memory_order_relaxed); }
+}
+
+void Metrics::response(int status)
+{
+    const auto cls(std::min(std::max(status / 100, 1), 5) - 1);
+    add(static_cast<Counter>
+        (static_cast<unsigned>(Counter::responses1xx) + cls));
+}
+
+Metrics::Snapshot Metrics::snapshot() const
+{
+    Snapshot snapshot;
+    std::fill(std::begin(snapshot.values), std::end(snapshot.values), 0);
+
+    shards_.forEach([&](const Shard &shard)
+    {
+        for (unsigned i(0); i < counterCount; ++i) {
+            snapshot.values[i]
+                += shard.values[i].load(std::memory_order_relaxed);
+        }
+    });
+    return snapshot;
+}
+
+} } // namespace http::detail
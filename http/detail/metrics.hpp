@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef http_detail_metrics_hpp_included_
+#define http_detail_metrics_hpp_included_
+
+#include <cstdint>
+#include <atomic>
+
+#include <boost/noncopyable.hpp>
+
+#include "threadshards.hpp"
+
+namespace http { namespace detail {
+
+/** Sharded event counters.
+ *
+ *  Each thread updates its own shard (allocated on first use) without any
+ *  synchronization, readers sum all shards. No thread is ever stopped to
+ *  gather values.
+ */
+class Metrics : boost::noncopyable {
+public:
+    enum class Counter {
+        connectionsAccepted
+        , connectionsClosed
+        , requestsDispatched
+        , requestsFinished
+        , bytesIn
+        , bytesQueued
+        , bytesDrained
+        , bytesOut
+        , responses1xx
+        , responses2xx
+        , responses3xx
+        , responses4xx
+        , responses5xx
+        , clientTransfersStarted
+        , clientTransfersCompleted
+        , clientTransfersFailed
+        , clientBytesIn
+        , clientSocketsOpened
+        , clientDispatchSpillovers
+        , clientTransfersQueued
+        , clientTransfersCancelled
+    };
+
+    enum : unsigned { counterCount = 21 };
+
+    struct Snapshot {
+        std::uint64_t values[counterCount];
+
+        std::uint64_t operator[](Counter counter) const {
+            return values[static_cast<unsigned>(counter)];
+        }
+    };
+
+    /** Adds value to counter in calling thread's shard.
+     */
+    void add(Counter counter, std::uint64_t value = 1) {
+        auto &v(shards_.local().values[static_cast<unsigned>(counter)]);
+        v.store(v.load(std::memory_order_relaxed) + value
+                , std::memory_order_relaxed);
+    }
+
+    /** Counts response of given status code.
+     */
+    void response(int status);
+
+    /** Sums all shards.
+     */
+    Snapshot snapshot() const;
+
+private:
+    struct Shard {
+        std::atomic<std::uint64_t> values[counterCount];
+
+        Shard();
+    };
+
+    ThreadShards<Shard> shards_;
+};
+
+} } // namespace http::detail
+
+#endif // http_detail_metrics_hpp_included_
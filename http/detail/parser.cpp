@@ -0,0 +1,252 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+
+#include "scan.hpp"
+#include "parser.hpp"
+
+namespace http { namespace detail {
+
+namespace scan {
+
+const std::uint8_t tokenTable[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 1, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+namespace {
+
+inline int hexValue(char c)
+{
+    if ((c >= '0') && (c <= '9')) { return c - '0'; }
+    if ((c >= 'a') && (c <= 'f')) { return c - 'a' + 10; }
+    if ((c >= 'A') && (c <= 'F')) { return c - 'A' + 10; }
+    return -1;
+}
+
+} // namespace
+
+std::size_t urlDecode(char *data, std::size_t size, bool plusIsSpace)
+{
+    const char *r(data);
+    const char *e(data + size);
+    char *w(data);
+
+    for (;;) {
+        // skip (and move) everything up to next special character
+        const auto *special(plusIsSpace ? find(r, e, '%', '+')
+                            : find(r, e, '%'));
+        if (w != r) { std::memmove(w, r, special - r); }
+        w += special - r;
+        r = special;
+
+        if (r == e) { break; }
+
+        if (*r == '+') {
+            *w++ = ' ';
+            ++r;
+            continue;
+        }
+
+        // percent sign
+        int hi, lo;
+        if (((e - r) >= 3) && ((hi = hexValue(r[1])) >= 0)
+            && ((lo = hexValue(r[2])) >= 0))
+        {
+            *w++ = char((hi << 4) | lo);
+            r += 3;
+        } else {
+            // invalid escape, keep as is
+            *w++ = *r++;
+        }
+    }
+
+    return w - data;
+}
+
+std::size_t removeDotSegments(char *data, std::size_t size)
+{
+    const char *e(data + size);
+
+    // fast path: nothing to do if there is no segment starting with a dot
+    {
+        const char *dot(data);
+        for (;;) {
+            dot = find(dot, e, '.');
+            if (dot == e) { return size; }
+            if ((dot == data) || (dot[-1] == '/')) { break; }
+            ++dot;
+        }
+    }
+
+    // input buffer: [r, e), output buffer [data, w); w <= r always holds
+    char *r(data);
+    char *w(data);
+
+    const auto left([&]() { return std::size_t(e - r); });
+    const auto startsWith([&](const char *prefix, std::size_t len) {
+            return (left() >= len) && !std::memcmp(r, prefix, len);
+        });
+    const auto is([&](const char *what, std::size_t len) {
+            return (left() == len) && !std::memcmp(r, what, len);
+        });
+    const auto popSegment([&]() {
+            while ((w != data) && (*--w != '/'));
+        });
+
+    while (r != e) {
+        if (startsWith("../", 3)) {
+            // A
+            r += 3;
+        } else if (startsWith("./", 2)) {
+            // A
+            r += 2;
+        } else if (startsWith("/./", 3)) {
+            // B: replace with "/"
+            r += 2;
+        } else if (is("/.", 2)) {
+            // B: replace with "/"
+            r += 1;
+            *r = '/';
+        } else if (startsWith("/../", 4)) {
+            // C: replace with "/", remove last output segment
+            r += 3;
+            popSegment();
+        } else if (is("/..", 3)) {
+            // C: replace with "/", remove last output segment
+            r += 2;
+            *r = '/';
+            popSegment();
+        } else if (is(".", 1) || is("..", 2)) {
+            // D
+            r = const_cast<char*>(e);
+        } else {
+            // E: move first segment (including leading slash) to output
+            const auto *end(find(r + 1, e, '/'));
+            if (w != r) { std::memmove(w, r, end - r); }
+            w += end - r;
+            r += end - r;
+        }
+    }
+
+    return w - data;
+}
+
+} // namespace scan
+
+bool parseRequestLine(Request &request, const char *data, std::size_t size)
+{
+    if ((size < 2) || (data[size - 2] != '\r')) { return false; }
+    const char *e(data + size - 2);
+
+    // METHOD SP URI SP VERSION CRLF
+
+    const auto *sp1(scan::find(data, e, ' '));
+    if ((sp1 == data) || (sp1 == e)
+        || (scan::findNonToken(data, sp1) != sp1))
+    {
+        return false;
+    }
+
+    const auto *uri(sp1 + 1);
+    const auto *sp2(scan::find(uri, e, ' '));
+    if ((sp2 == uri) || (sp2 == e)) { return false; }
+
+    const auto *version(sp2 + 1);
+    if ((version == e) || (scan::find(version, e, ' ', '\t') != e)) {
+        return false;
+    }
+
+    request.method.assign(data, sp1);
+    request.uri.assign(uri, sp2);
+    request.version.assign(version, e);
+
+    splitUri(request);
+    return true;
+}
+
+bool parseHeaderLine(Request &request, const char *data, std::size_t size)
+{
+    if ((size < 2) || (data[size - 2] != '\r')) { return false; }
+    const char *e(data + size - 2);
+
+    if ((*data == ' ') || (*data == '\t')) {
+        // previous header line continuation
+        if (request.headers.empty()) { return false; }
+        request.headers.back().value.append(data, e);
+        return true;
+    }
+
+    const auto *colon(scan::find(data, e, ':'));
+    if ((colon == data) || (colon == e)
+        || (scan::findNonToken(data, colon) != colon))
+    {
+        return false;
+    }
+
+    request.headers.emplace_back();
+    auto &header(request.headers.back());
+    header.name.assign(data, colon);
+    header.value.assign(colon + 1, e);
+    return true;
+}
+
+void splitUri(Request &request)
+{
+    const auto &uri(request.uri);
+    const auto qm(uri.find('?'));
+
+    auto &path(request.path);
+    if (qm != std::string::npos) {
+        path.assign(uri, 0, qm);
+        request.query.assign(uri, qm + 1, std::string::npos);
+    } else {
+        path = uri;
+        request.query.clear();
+    }
+    request.resetParams();
+
+    // decode and normalize in place
+    path.resize(scan::urlDecode(&path[0], path.size()));
+    path.resize(scan::removeDotSegments(&path[0], path.size()));
+}
+
+} } // namespace http::detail
@@ -0,0 +1,61 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef http_detail_parser_hpp_included_
+#define http_detail_parser_hpp_included_
+
+#include <cstddef>
+
+#include "types.hpp"
+
+namespace http { namespace detail {
+
+/** Parses request line (method, URI, version). Path and query are split
+ *  from URI.
+ *
+ * \param request request to fill in
+ * \param data line data, including terminating CRLF
+ * \param size size of line data
+ * \return false if line is malformed
+ */
+bool parseRequestLine(Request &request, const char *data, std::size_t size);
+
+/** Parses single header line. Continuation line is appended to the value
+ *  of previous header.
+ *
+ * \param request request to fill in
+ * \param data line data, including terminating CRLF
+ * \param size size of line data
+ * \return false if line is malformed
+ */
+bool parseHeaderLine(Request &request, const char *data, std::size_t size);
+
+/** Splits request URI into decoded and normalized path and raw query.
+ */
+void splitUri(Request &request);
+
+} } // namespace http::detail
+
+#endif // http_detail_parser_hpp_included_
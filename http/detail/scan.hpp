@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef http_detail_scan_hpp_included_
+#define http_detail_scan_hpp_included_
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#  include <emmintrin.h>
+#  define HTTP_SCAN_SSE2 1
+#  if defined(__AVX2__)
+#    include <immintrin.h>
+#    define HTTP_SCAN_AVX2 1
+#  endif
+#endif
+
+/** Scanners used by request parser. Vectorized (AVX2/SSE2) when compiled
+ *  with appropriate instruction set enabled, scalar otherwise.
+ */
+
+namespace http { namespace detail { namespace scan {
+
+/** Finds first occurrence of character c in [b, e).
+ *
+ * \return pointer to found character or e if not found
+ */
+inline const char* find(const char *b, const char *e, char c)
+{
+#ifdef HTTP_SCAN_AVX2
+    {
+        const auto needle(::_mm256_set1_epi8(c));
+        for (; (e - b) >= 32; b += 32) {
+            const auto block(::_mm256_loadu_si256
+                             (reinterpret_cast<const __m256i*>(b)));
+            if (const unsigned int mask = ::_mm256_movemask_epi8
+                (::_mm256_cmpeq_epi8(block, needle)))
+            {
+                return b + __builtin_ctz(mask);
+            }
+        }
+    }
+#endif
+
+#ifdef HTTP_SCAN_SSE2
+    {
+        const auto needle(::_mm_set1_epi8(c));
+        for (; (e - b) >= 16; b += 16) {
+            const auto block(::_mm_loadu_si128
+                             (reinterpret_cast<const __m128i*>(b)));
+            if (const unsigned int mask = ::_mm_movemask_epi8
+                (::_mm_cmpeq_epi8(block, needle)))
+            {
+                return b + __builtin_ctz(mask);
+            }
+        }
+    }
+#endif
+
+    // scalar tail
+    for (; b != e; ++b) {
+        if (*b == c) { return b; }
+    }
+    return e;
+}
+
+/** Finds first occurrence of either character c1 or c2 in [b, e).
+ *
+ * \return pointer to found character or e if not found
+ */
+inline const char* find(const char *b, const char *e, char c1, char c2)
+{
+#ifdef HTTP_SCAN_AVX2
+    {
+        const auto n1(::_mm256_set1_epi8(c1));
+        const auto n2(::_mm256_set1_epi8(c2));
+        for (; (e - b) >= 32; b += 32) {
+            const auto block(::_mm256_loadu_si256
+                             (reinterpret_cast<const __m256i*>(b)));
+            if (const unsigned int mask = ::_mm256_movemask_epi8
+                (::_mm256_or_si256(::_mm256_cmpeq_epi8(block, n1)
+                                   , ::_mm256_cmpeq_epi8(block, n2))))
+            {
+                return b + __builtin_ctz(mask);
+            }
+        }
+    }
+#endif
+
+#ifdef HTTP_SCAN_SSE2
+    {
+        const auto n1(::_mm_set1_epi8(c1));
+        const auto n2(::_mm_set1_epi8(c2));
+        for (; (e - b) >= 16; b += 16) {
+            const auto block(::_mm_loadu_si128
+                             (reinterpret_cast<const __m128i*>(b)));
+            if (const unsigned int mask = ::_mm_movemask_epi8
+                (::_mm_or_si128(::_mm_cmpeq_epi8(block, n1)
+                                , ::_mm_cmpeq_epi8(block, n2))))
+            {
+                return b + __builtin_ctz(mask);
+            }
+        }
+    }
+#endif
+
+    // scalar tail
+    for (; b != e; ++b) {
+        if ((*b == c1) || (*b == c2)) { return b; }
+    }
+    return e;
+}
+
+/** RFC 7230 tchar table.
+ */
+extern const std::uint8_t tokenTable[256];
+
+inline bool isToken(char c)
+{
+    return tokenTable[static_cast<unsigned char>(c)];
+}
+
+/** Finds first character in [b, e) that is not a token character.
+ *
+ *  NB: tokens (methods, header names) are short, table lookup beats any
+ *  vectorized range/set check here.
+ *
+ * \return pointer to found character or e if all characters are valid
+ */
+inline const char* findNonToken(const char *b, const char *e)
+{
+    for (; b != e; ++b) {
+        if (!isToken(*b)) { return b; }
+    }
+    return e;
+}
+
+/** Decodes percent-encoded characters in place. Invalid escape sequences are
+ *  kept as is. '+' is decoded as space only when plusIsSpace is set.
+ *
+ * \return new size of data
+ */
+std::size_t urlDecode(char *data, std::size_t size, bool plusIsSpace = false);
+
+/** Removes dot segments from path in place (RFC 3986, section 5.2.4).
+ *
+ * \return new size of data
+ */
+std::size_t removeDotSegments(char *data, std::size_t size);
+
+} } } // namespace http::detail::scan
+
+#endif // http_detail_scan_hpp_included_
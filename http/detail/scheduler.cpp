@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+
+#include "scheduler.hpp"
+
+namespace http { namespace detail {
+
+namespace {
+
+/** Stride of priority level, inversely proportional to its weight.
+ */
+inline std::uint64_t stride(int priority)
+{
+    return (std::uint64_t(1) << 20)
+        / (std::uint64_t(std::max(priority, 0)) + 1);
+}
+
+} // namespace
+
+Scheduler::Scheduler(const ContentFetcher::Options *options)
+    : maxHostTransfers_(options ? options->maxHostTransfers : 0)
+    , weighted_(options && (options->scheduling
+                            == ContentFetcher::Options::Scheduling
+                            ::weightedFair))
+    , queued_()
+{}
+
+std::string Scheduler::hostKey(const std::string &location)
+{
+    const auto scheme(location.find("://"));
+    const auto start((scheme == std::string::npos) ? 0 : scheme + 3);
+    const auto end(location.find_first_of("/?#", start));
+    return location.substr(0, end);
+}
+
+bool Scheduler::admit(const Submission::pointer &submission)
+{
+    auto &host(hosts_[submission->host]);
+    if (host.running < maxHostTransfers_) {
+        ++host.running;
+        return true;
+    }
+
+    auto &level(host.levels[submission->options.priority]);
+    if (level.queue.empty()) {
+        // no credit for idle time
+        level.pass = std::max(level.pass, host.vtime);
+    }
+    level.queue.push_back(submission);
+    ++host.queued;
+    ++queued_;
+    return false;
+}
+
+Submission::pointer Scheduler::release(const std::string &key)
+{
+    auto fhosts(hosts_.find(key));
+    if (fhosts == hosts_.end()) { return {}; }
+    auto &host(fhosts->second);
+
+    if (!host.queued) {
+        if (host.running) { --host.running; }
+        if (!host.running) { hosts_.erase(fhosts); }
+        return {};
+    }
+
+    // slot goes directly to the next submission
+    return next(host);
+}
+
+bool Scheduler::cancel(const Submission::pointer &submission)
+{
+    auto fhosts(hosts_.find(submission->host));
+    if (fhosts == hosts_.end()) { return false; }
+    auto &host(fhosts->second);
+
+    auto flevels(host.levels.find(submission->options.priority));
+    if (flevels == host.levels.end()) { return false; }
+    auto &queue(flevels->second.queue);
+
+    auto fqueue(std::find(queue.begin(), queue.end(), submission));
+    if (fqueue == queue.end()) { return false; }
+
+    queue.erase(fqueue);
+    --host.queued;
+    --queued_;
+
+    if (queue.empty() && !weighted_) {
+        host.levels.erase(flevels);
+    }
+    return true;
+}
+
+Submission::pointer Scheduler::next(Host &host)
+{
+    auto select(host.levels.end());
+    for (auto ilevels(host.levels.begin()), elevels(host.levels.end());
+         ilevels != elevels; ++ilevels)
+    {
+        if (ilevels->second.queue.empty()) { continue; }
+
+        if (!weighted_) {
+            // strict: first non-empty level is the highest priority one
+            select = ilevels;
+            break;
+        }
+
+        // weighted: lowest pass wins, ties go to higher priority
+        if ((select == elevels)
+            || (ilevels->second.pass < select->second.pass))
+        {
+            select = ilevels;
+        }
+    }
+
+    auto &level(select->second);
+    auto submission(std::move(level.queue.front()));
+    level.queue.pop_front();
+    --host.queued;
+    --queued_;
+
+    if (weighted_) {
+        host.vtime = level.pass;
+        level.pass += stride(select->first);
+    }
+
+    if (level.queue.empty() && !weighted_) {
+        host.levels.erase(select);
+    }
+    return submission;
+}
+
+} } // namespace http::detail
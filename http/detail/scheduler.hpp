@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef http_detail_scheduler_hpp_included_
+#define http_detail_scheduler_hpp_included_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "../sink.hpp"
+#include "../contentfetcher.hpp"
+
+namespace http { namespace detail {
+
+class ClientConnection;
+
+/** Request submitted to CURL client.
+ */
+struct Submission {
+    typedef std::shared_ptr<Submission> pointer;
+
+    /** Life cycle of submission. Maintained by client thread (except for
+     *  initial pending/delayed state).
+     */
+    enum class State {
+        /** In submission queue. */
+        pending
+        /** Waiting for its delay timer. */
+        , delayed
+        /** Waiting in scheduler queue for per-host slot. */
+        , queued
+        /** Holds slot (if scheduled), being resolved. */
+        , admitted
+        /** Transfer running in the multi handle. */
+        , running
+        /** Sink has been (or is being) notified. */
+        , finished
+    };
+
+    std::string location;
+    ClientSink::pointer sink;
+    ContentFetcher::RequestOptions options;
+
+    /** Scheduling key (scheme://authority), empty if not scheduled.
+     */
+    std::string host;
+
+    State state;
+
+    /** Delay timer (valid in delayed state).
+     */
+    std::shared_ptr<boost::asio::steady_timer> timer;
+
+    /** Running transfer (valid in running state).
+     */
+    ClientConnection *connection;
+
+    /** Link in submission queue.
+     */
+    Submission *next;
+
+    /** Reference held by submission queue.
+     */
+    pointer self;
+
+    Submission(const std::string &location
+               , const ClientSink::pointer &sink
+               , const ContentFetcher::RequestOptions &options)
+        : location(location), sink(sink), options(options)
+        , state(State::pending), connection(), next()
+    {}
+};
+
+/** Per-host admission control in front of CURL multi handle.
+ *
+ *  At most maxHostTransfers submissions per host are running at once, the
+ *  rest wait in per-host queues ordered by RequestOptions::priority:
+ *
+ *  * strict: higher priority always goes first
+ *  * weighted-fair: stride scheduling, priority level p gets share of
+ *    host's slots proportional to p + 1 (negative priority counts as 0),
+ *    i.e. low priority traffic is never starved
+ *
+ *  Same priority is served in FIFO order. Not thread-safe, used by single
+ *  client thread.
+ */
+class Scheduler : boost::noncopyable {
+public:
+    Scheduler(const ContentFetcher::Options *options);
+
+    /** Scheduling is enabled only when there is a per-host limit.
+     */
+    bool enabled() const { return maxHostTransfers_; }
+
+    /** Admits submission: returns true if it can be started right away,
+     *  otherwise it is queued.
+     */
+    bool admit(const Submission::pointer &submission);
+
+    /** Releases slot of finished submission.
+     *
+     * \return next submission to start (slot already taken) or null
+     */
+    Submission::pointer release(const std::string &host);
+
+    /** Removes queued submission.
+     *
+     * \return true if submission has been found in its host's queue
+     */
+    bool cancel(const Submission::pointer &submission);
+
+    /** Number of queued submissions.
+     */
+    std::size_t queued() const { return queued_; }
+
+    /** Returns scheduling key of given URL (scheme and authority).
+     */
+    static std::string hostKey(const std::string &location);
+
+private:
+    struct Level {
+        std::deque<Submission::pointer> queue;
+
+        /** Stride scheduling pass.
+         */
+        std::uint64_t pass;
+
+        Level() : pass() {}
+    };
+
+    struct Host {
+        std::size_t running;
+        std::size_t queued;
+
+        /** Levels by priority, highest first.
+         */
+        std::map<int, Level, std::greater<int>> levels;
+
+        /** Pass of last served level.
+         */
+        std::uint64_t vtime;
+
+        Host() : running(), queued(), vtime() {}
+    };
+
+    Submission::pointer next(Host &host);
+
+    const std::size_t maxHostTransfers_;
+    const bool weighted_;
+
+    std::unordered_map<std::string, Host> hosts_;
+    std::size_t queued_;
+};
+
+} } // namespace http::detail
+
+#endif // http_detail_scheduler_hpp_included_
@@ -29,13 +29,18 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <deque>
+#include <atomic>
 
 #include "utility/enum-io.hpp"
 
 #include "detail.hpp"
+#include "transport.hpp"
 
 namespace http { namespace detail {
 
+class ChunkedWriter;
+
 class ServerConnection
     : boost::noncopyable
     , public std::enable_shared_from_this<ServerConnection>
@@ -48,13 +53,20 @@ public:
                , const ContentGenerator::pointer &contentGenerator)
         : id_(++idGenerator_)
         , lm_(dbglog::make_module(str(boost::format("conn:%s") % id_)))
-        , owner_(owner), ios_(ios), strand_(ios), socket_(ios_)
+        , owner_(owner), ios_(ios), strand_(ios), transport_(ios_)
         , requestData_(1 << 13) // max line size; TODO: make configurable
+        , traceId_(0)
+        , inFlight_(false)
         , state_(State::ready)
         , contentGenerator_(contentGenerator)
     {}
 
-    tcp::socket& socket() {return  socket_; }
+    tcp::socket& socket() { return transport_.socket(); }
+
+    /** Switches connection to in-memory transport. Must be called before
+     *  start().
+     */
+    void pipe(const MemoryPipe::pointer &pipe) { transport_.pipe(pipe); }
 
     void sendResponse(const Request &request, const Response &response
                       , const std::string &data, bool persistent = false)
@@ -69,6 +81,15 @@ public:
     void sendResponse(const Request &request, const Response &response
                       , const SinkBase::DataSource::pointer &source);
 
+    void sendResponse(const Request &request, const Response &response
+                      , const SinkBase::Fragment::list &fragments);
+
+    /** Starts chunked response. Response body is pushed via returned
+     *  writer.
+     */
+    std::shared_ptr<ChunkedWriter>
+    sendChunked(const Request &request, const Response &response);
+
     void start();
 
     bool valid() const;
@@ -85,6 +106,35 @@ public:
 
     void countRequest() { owner_.request(); }
 
+    /** Counts dispatched request as finished. Called on every exit (response
+     *  sent, connection closed); only the first call per request counts.
+     */
+    void finishRequest() {
+        if (inFlight_.exchange(false)) {
+            metrics().add(Metrics::Counter::requestsFinished);
+        }
+    }
+
+    long slowRequestThreshold() const {
+        return owner_.slowRequestThreshold();
+    }
+
+    Metrics& metrics() { return owner_.metrics(); }
+
+    Tracer& tracer() { return owner_.tracer(); }
+
+    std::size_t id() const { return id_; }
+
+    AccessLog* accessLog() const { return owner_.accessLog(); }
+
+    LatencyStats& latency() { return owner_.latency(); }
+
+    /** Time when the current response has been started.
+     */
+    Request::Clock::time_point responseStarted() const {
+        return responseStarted_;
+    }
+
 private:
     void startRequest();
     void readRequest();
@@ -99,6 +149,23 @@ private:
     void process();
     void badRequest();
 
+    /** Writes status line and common headers.
+     */
+    void writeHeader(std::ostream &os, const Request &request
+                     , const Response &response);
+
+    /** Response has been sent.
+     */
+    void responseSent(const Request &request, const Response &response
+                      , const bs::error_code &ec, std::size_t bytes);
+
+    /** Writes buffers to the transport. Accounts queued and written bytes.
+     *  Whole write (including its intermediate steps) and the handler run
+     *  in the connection's strand.
+     */
+    template <typename Buffers, typename Handler>
+    void write(const Buffers &buffers, Handler handler);
+
     void close();
     void close(const bs::error_code &ec);
 
@@ -106,6 +173,8 @@ private:
 
     void aborted();
 
+    friend class ChunkedWriter;
+
     static std::atomic<std::size_t> idGenerator_;
 
     std::atomic<std::size_t> id_;
@@ -115,11 +184,20 @@ private:
 
     asio::io_service &ios_;
     asio::io_service::strand strand_;
-    tcp::socket socket_;
+    Transport transport_;
     asio::streambuf requestData_;
     asio::streambuf responseData_;
 
     Request::list requests_;
+    Request::Clock::time_point responseStarted_;
+
+    /** Trace id of request being processed.
+     */
+    std::uint64_t traceId_;
+
+    /** Dispatched request not counted as finished yet.
+     */
+    std::atomic<bool> inFlight_;
 
     enum class State { ready, busy, busyClose, closed };
     State state_;
@@ -129,6 +207,87 @@ private:
     ContentGenerator::pointer contentGenerator_;
 };
 
+/** Sends chunked body of a response. Chunks are sent in order in which they
+ *  were written.
+ *
+ *  Both write() and finish() are thread safe.
+ */
+class ChunkedWriter
+    : boost::noncopyable
+    , public std::enable_shared_from_this<ChunkedWriter>
+{
+public:
+    typedef std::shared_ptr<ChunkedWriter> pointer;
+
+    ChunkedWriter(const ServerConnection::pointer &conn
+                  , const Request &request, const Response &response)
+        : conn_(conn), request_(request), response_(response)
+        , writing_(true), finished_(false), terminated_(false), total_()
+    {}
+
+    /** Queues one chunk (gathered from given fragments) to be sent.
+     */
+    void write(SinkBase::Fragment::list &&fragments);
+
+    /** Sends terminating chunk once all queued chunks are sent.
+     */
+    void finish();
+
+    /** Sends response headers. Called by connection.
+     */
+    void start();
+
+private:
+    void flush();
+    void sent(const bs::error_code &ec, std::size_t bytes);
+
+    ServerConnection::pointer conn_;
+    Request request_;
+    Response response_;
+
+    /** Chunks waiting to be sent.
+     */
+    std::deque<SinkBase::Fragment::list> queue_;
+
+    /** Chunks being sent, kept alive until written.
+     */
+    std::vector<SinkBase::Fragment::list> inflight_;
+    std::vector<std::string> framing_;
+
+    bool writing_;
+    bool finished_;
+    bool terminated_;
+    std::size_t total_;
+};
+
+// inlines
+
+template <typename Buffers, typename Handler>
+void ServerConnection::write(const Buffers &buffers, Handler handler)
+{
+    const auto size(asio::buffer_size(buffers));
+    auto *metrics(&owner_.metrics());
+    metrics->add(Metrics::Counter::bytesQueued, size);
+
+    auto *tracer(traceId_ ? &owner_.tracer() : nullptr);
+    const auto traceId(traceId_);
+    const auto start(tracer ? Tracer::Clock::now()
+                     : Tracer::Clock::time_point());
+
+    asio::async_write(transport_, buffers, strand_.wrap
+                      ([metrics, size, tracer, traceId, start, handler]
+                       (const bs::error_code &ec, std::size_t bytes) mutable
+    {
+        metrics->add(Metrics::Counter::bytesDrained, size);
+        metrics->add(Metrics::Counter::bytesOut, bytes);
+        if (tracer) {
+            tracer->span("socket.write", traceId, start
+                         , Tracer::Clock::now());
+        }
+        handler(ec, bytes);
+    }));
+}
+
 } } // namespace http::detail
 
 #endif // http_detail_serverconnection_hpp_included_
@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef http_detail_threadshards_hpp_included_
+#define http_detail_threadshards_hpp_included_
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+
+namespace http { namespace detail {
+
+/** Per-thread instances of T. Calling thread gets its own instance on first
+ *  use; instances live as long as this object (i.e. they survive their
+ *  threads).
+ */
+template <typename T>
+class ThreadShards : boost::noncopyable {
+public:
+    ThreadShards() : id_(nextId()) {}
+
+    /** Returns calling thread's instance.
+     */
+    T& local() {
+        // most recently registered shards are usually at the end
+        auto &cache(threadCache());
+        for (auto i(cache.rbegin()), e(cache.rend()); i != e; ++i) {
+            if (i->first == id_) { return *static_cast<T*>(i->second); }
+        }
+        return add();
+    }
+
+    /** Calls f(const T&) for each instance.
+     */
+    template <typename F>
+    void forEach(F f) const {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (const auto &shard : shards_) { f(*shard); }
+    }
+
+private:
+    typedef std::vector<std::pair<std::uint64_t, void*>> Cache;
+
+    static Cache& threadCache() {
+        static thread_local Cache cache;
+        return cache;
+    }
+
+    static std::uint64_t nextId() {
+        static std::atomic<std::uint64_t> generator(0);
+        return ++generator;
+    }
+
+    T& add() {
+        std::unique_ptr<T> shard(new T());
+        auto *s(shard.get());
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            shards_.push_back(std::move(shard));
+        }
+        threadCache().emplace_back(id_, s);
+        return *s;
+    }
+
+    /** Unique identifier, used as a key in thread's cache. Never reused.
+     */
+    const std::uint64_t id_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<T>> shards_;
+};
+
+} } // namespace http::detail
+
+#endif // http_detail_threadshards_hpp_included_
@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include "trace.hpp"
+
+namespace http { namespace detail {
+
+namespace {
+
+void escape(std::ostream &os, const std::string &value)
+{
+    const char *hex = "0123456789abcdef";
+    for (const auto c : value) {
+        switch (c) {
+        case '"': os << "\\\""; break;
+        case '\\': os << "\\\\"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                os << "\\u00" << hex[(c >> 4) & 0xf] << hex[c & 0xf];
+            } else {
+                os << c;
+            }
+        }
+    }
+}
+
+} // namespace
+
+Tracer::Tracer()
+    : rate_(0), capacity_(1 << 14), idGenerator_(0), tidGenerator_(0)
+    , epoch_(Clock::now())
+{}
+
+void Tracer::configure(unsigned rate, std::size_t capacity)
+{
+    capacity_ = std::max<std::size_t>(capacity, 1);
+    rate_ = rate;
+}
+
+Tracer::Buffer& Tracer::local()
+{
+    auto &buffer(buffers_.local());
+    if (!buffer.tid) { buffer.tid = ++tidGenerator_; }
+    return buffer;
+}
+
+void Tracer::span(const char *name, std::uint64_t id
+                  , Clock::time_point start, Clock::time_point end
+                  , const std::string &detail)
+{
+    if (!id) { return; }
+
+    auto &buffer(local());
+    const auto capacity(capacity_.load(std::memory_order_relaxed));
+
+    // NB: lock is contended only while dumping
+    std::unique_lock<std::mutex> lock(buffer.mutex);
+    if (buffer.spans.size() != capacity) {
+        // (re)configured
+        buffer.spans.resize(capacity);
+        buffer.next = 0;
+    }
+
+    auto &span(buffer.spans[buffer.next++ % capacity]);
+    span.name = name;
+    span.id = id;
+    span.start = start;
+    span.end = end;
+    span.detail = detail;
+}
+
+void Tracer::dump(std::ostream &os) const
+{
+    const auto us([this](Clock::time_point t) -> long long
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>
+            (t - epoch_).count();
+    });
+
+    os << "{\"traceEvents\":[";
+    bool first(true);
+    buffers_.forEach([&](const Buffer &buffer)
+    {
+        std::unique_lock<std::mutex> lock(buffer.mutex);
+        const auto count(std::min(buffer.next, buffer.spans.size()));
+        for (std::size_t i(0); i < count; ++i) {
+            const auto &span(buffer.spans[i]);
+            if (!first) { os << ','; }
+            first = false;
+
+            os << "\n{\"name\":\"" << span.name
+               << "\",\"cat\":\"http\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+               << buffer.tid
+               << ",\"ts\":" << us(span.start)
+               << ",\"dur\":" << std::max(0ll, us(span.end) - us(span.start))
+               << ",\"args\":{\"id\":" << span.id;
+            if (!span.detail.empty()) {
+                os << ",\"detail\":\"";
+                escape(os, span.detail);
+                os << '"';
+            }
+            os << "}}";
+        }
+    });
+    os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+} } // namespace http::detail
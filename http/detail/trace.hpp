@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef http_detail_trace_hpp_included_
+#define http_detail_trace_hpp_included_
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include <boost/noncopyable.hpp>
+
+#include "threadshards.hpp"
+
+namespace http { namespace detail {
+
+/** Sampled request lifecycle tracer.
+ *
+ *  Every n-th request (per thread) gets a non-zero trace id; spans of traced
+ *  requests are stored in per-thread ring buffers (oldest spans are
+ *  overwritten) and can be dumped in Chrome trace-event format (load in
+ *  chrome://tracing or Perfetto).
+ */
+class Tracer : boost::noncopyable {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    Tracer();
+
+    /** Sets sampling rate (trace every rate-th request, 0 disables tracing)
+     *  and per-thread buffer capacity. Can be called any time.
+     */
+    void configure(unsigned rate, std::size_t capacity);
+
+    /** Returns new trace id if the request should be traced, 0 otherwise.
+     */
+    std::uint64_t sample();
+
+    /** Records span. No-op for zero trace id.
+     *
+     * \param name span name, must be a string literal
+     * \param id trace id
+     * \param start span start
+     * \param end span end
+     * \param detail optional detail (e.g. URI)
+     */
+    void span(const char *name, std::uint64_t id
+              , Clock::time_point start, Clock::time_point end
+              , const std::string &detail = std::string());
+
+    /** Dumps all recorded spans as Chrome trace-event JSON.
+     */
+    void dump(std::ostream &os) const;
+
+private:
+    struct Span {
+        const char *name;
+        std::uint64_t id;
+        Clock::time_point start;
+        Clock::time_point end;
+        std::string detail;
+    };
+
+    struct Buffer {
+        mutable std::mutex mutex;
+        std::vector<Span> spans;
+        std::size_t next;
+        unsigned tid;
+        unsigned counter;
+
+        Buffer() : next(), tid(), counter() {}
+    };
+
+    Buffer& local();
+
+    std::atomic<unsigned> rate_;
+    std::atomic<std::size_t> capacity_;
+    std::atomic<std::uint64_t> idGenerator_;
+    std::atomic<unsigned> tidGenerator_;
+    const Clock::time_point epoch_;
+
+    ThreadShards<Buffer> buffers_;
+};
+
+// inlines
+
+inline std::uint64_t Tracer::sample()
+{
+    const auto rate(rate_.load(std::memory_order_relaxed));
+    if (!rate) { return 0; }
+
+    auto &buffer(local());
+    if (++buffer.counter < rate) { return 0; }
+    buffer.counter = 0;
+    return ++idGenerator_;
+}
+
+} } // namespace http::detail
+
+#endif // http_detail_trace_hpp_included_
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "transport.hpp"
+
+namespace http { namespace detail {
+
+void MemoryPipe::post(const Op::pointer &op, const bs::error_code &ec
+                      , std::size_t bytes)
+{
+    ios_.post([op, ec, bytes]() { op->complete(ec, bytes); });
+}
+
+std::size_t MemoryPipe::fill(Op &op)
+{
+    const auto bytes(op.fill(in_.data() + inOff_, in_.size() - inOff_));
+    inOff_ += bytes;
+    if (inOff_ == in_.size()) {
+        // everything consumed, rewind
+        in_.clear();
+        inOff_ = 0;
+    }
+    return bytes;
+}
+
+void MemoryPipe::serverClose()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (serverClosed_) { return; }
+    serverClosed_ = true;
+    cond_.notify_all();
+
+    if (readOp_) {
+        post(readOp_, asio::error::operation_aborted, 0);
+        readOp_.reset();
+    }
+}
+
+void MemoryPipe::write_impl(const void *data, std::size_t size)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (serverClosed_ || clientClosed_) { return; }
+
+    const auto *d(static_cast<const char*>(data));
+    in_.insert(in_.end(), d, d + size);
+
+    if (readOp_) {
+        // wake up pending read
+        post(readOp_, bs::error_code(), fill(*readOp_));
+        readOp_.reset();
+    }
+}
+
+std::size_t MemoryPipe::read_impl(void *data, std::size_t size)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]()
+    {
+        return (outOff_ < out_.size()) || serverClosed_;
+    });
+
+    const auto bytes(std::min(size, out_.size() - outOff_));
+    std::memcpy(data, out_.data() + outOff_, bytes);
+    outOff_ += bytes;
+    if (outOff_ == out_.size()) {
+        // everything consumed, rewind
+        out_.clear();
+        outOff_ = 0;
+    }
+    return bytes;
+}
+
+void MemoryPipe::close_impl()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (clientClosed_) { return; }
+    clientClosed_ = true;
+
+    if (readOp_) {
+        post(readOp_, asio::error::eof, 0);
+        readOp_.reset();
+    }
+}
+
+void Transport::close(bs::error_code &ec)
+{
+    if (pipe_) {
+        pipe_->serverClose();
+        return;
+    }
+    socket_.close(ec);
+}
+
+} } // namespace http::detail
@@ -0,0 +1,266 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef http_detail_transport_hpp_included_
+#define http_detail_transport_hpp_included_
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <vector>
+
+#include <boost/version.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/asio.hpp>
+
+#include "../memorystream.hpp"
+
+namespace http { namespace detail {
+
+namespace asio = boost::asio;
+namespace bs = boost::system;
+typedef asio::ip::tcp tcp;
+
+/** In-memory duplex pipe. Server side mimics asynchronous socket
+ *  operations (completion handlers are always posted to the io_service),
+ *  client side is the blocking MemoryStream interface.
+ */
+class MemoryPipe
+    : boost::noncopyable
+    , public MemoryStream
+{
+public:
+    typedef std::shared_ptr<MemoryPipe> pointer;
+
+    MemoryPipe(asio::io_service &ios)
+        : ios_(ios), inOff_(), outOff_()
+        , clientClosed_(false), serverClosed_(false)
+    {}
+
+    template <typename MutableBufferSequence, typename Handler>
+    void serverRead(const MutableBufferSequence &buffers, Handler handler);
+
+    template <typename ConstBufferSequence, typename Handler>
+    void serverWrite(const ConstBufferSequence &buffers, Handler handler);
+
+    void serverClose();
+
+private:
+    virtual void write_impl(const void *data, std::size_t size);
+    virtual std::size_t read_impl(void *data, std::size_t size);
+    virtual void close_impl();
+
+    /** Type-erased pending operation.
+     */
+    struct Op {
+        typedef std::shared_ptr<Op> pointer;
+        virtual ~Op() {}
+
+        /** Copies data into operation's buffers, returns bytes copied.
+         */
+        virtual std::size_t fill(const char *data, std::size_t size) = 0;
+
+        virtual void complete(const bs::error_code &ec
+                              , std::size_t bytes) = 0;
+    };
+
+    template <typename MutableBufferSequence, typename Handler>
+    struct HandlerOp;
+
+    template <typename MutableBufferSequence, typename Handler>
+    static Op::pointer makeOp(const MutableBufferSequence &buffers
+                              , Handler &&handler);
+
+    /** Posts operation completion. */
+    void post(const Op::pointer &op, const bs::error_code &ec
+              , std::size_t bytes);
+
+    /** Copies available inbound data to given read operation. Returns
+     *  number of bytes copied. Must be called under lock.
+     */
+    std::size_t fill(Op &op);
+
+    asio::io_service &ios_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+
+    /** Client -> server data. */
+    std::vector<char> in_;
+    std::size_t inOff_;
+
+    /** Server -> client data. */
+    std::vector<char> out_;
+    std::size_t outOff_;
+
+    /** Pending server-side read. */
+    Op::pointer readOp_;
+
+    bool clientClosed_;
+    bool serverClosed_;
+};
+
+/** Server connection byte stream: either TCP socket or (when pipe is set)
+ *  in-memory pipe. Models asio AsyncReadStream and AsyncWriteStream so it
+ *  can be used with asio composed operations. TCP path forwards directly to
+ *  the socket.
+ */
+class Transport : boost::noncopyable {
+public:
+    Transport(asio::io_service &ios) : ios_(ios), socket_(ios) {}
+
+    tcp::socket& socket() { return socket_; }
+
+    /** Switches transport to given in-memory pipe.
+     */
+    void pipe(const MemoryPipe::pointer &pipe) { pipe_ = pipe; }
+
+    template <typename MutableBufferSequence, typename Handler>
+    void async_read_some(const MutableBufferSequence &buffers
+                         , Handler &&handler);
+
+    template <typename ConstBufferSequence, typename Handler>
+    void async_write_some(const ConstBufferSequence &buffers
+                          , Handler &&handler);
+
+    void close(bs::error_code &ec);
+
+#if BOOST_VERSION >= 106600
+    typedef tcp::socket::executor_type executor_type;
+    executor_type get_executor() { return socket_.get_executor(); }
+#endif
+
+    asio::io_service& get_io_service() { return ios_; }
+
+private:
+    asio::io_service &ios_;
+    tcp::socket socket_;
+    MemoryPipe::pointer pipe_;
+};
+
+// inlines
+
+template <typename MutableBufferSequence, typename Handler>
+struct MemoryPipe::HandlerOp : Op {
+    HandlerOp(const MutableBufferSequence &buffers, Handler &&handler)
+        : buffers(buffers), handler(std::move(handler))
+    {}
+
+    virtual std::size_t fill(const char *data, std::size_t size) {
+        return asio::buffer_copy(buffers, asio::buffer(data, size));
+    }
+
+    virtual void complete(const bs::error_code &ec, std::size_t bytes) {
+        handler(ec, bytes);
+    }
+
+    MutableBufferSequence buffers;
+    Handler handler;
+};
+
+template <typename MutableBufferSequence, typename Handler>
+MemoryPipe::Op::pointer
+MemoryPipe::makeOp(const MutableBufferSequence &buffers, Handler &&handler)
+{
+    typedef typename std::decay<Handler>::type H;
+    return std::make_shared<HandlerOp<MutableBufferSequence, H>>
+        (buffers, H(std::forward<Handler>(handler)));
+}
+
+template <typename MutableBufferSequence, typename Handler>
+void MemoryPipe::serverRead(const MutableBufferSequence &buffers
+                            , Handler handler)
+{
+    auto op(makeOp(buffers, std::move(handler)));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (serverClosed_) {
+        post(op, asio::error::operation_aborted, 0);
+        return;
+    }
+
+    if (!asio::buffer_size(buffers)) {
+        // zero-length read completes immediately (used by composed ops)
+        post(op, bs::error_code(), 0);
+    } else if (const auto bytes = fill(*op)) {
+        post(op, bs::error_code(), bytes);
+    } else if (clientClosed_) {
+        post(op, asio::error::eof, 0);
+    } else {
+        readOp_ = op;
+    }
+}
+
+template <typename ConstBufferSequence, typename Handler>
+void MemoryPipe::serverWrite(const ConstBufferSequence &buffers
+                             , Handler handler)
+{
+    // write operation has no buffers to fill
+    auto op(makeOp(asio::mutable_buffers_1(nullptr, 0), std::move(handler)));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (serverClosed_) {
+        post(op, asio::error::operation_aborted, 0);
+        return;
+    }
+    if (clientClosed_) {
+        post(op, asio::error::broken_pipe, 0);
+        return;
+    }
+
+    const auto bytes(asio::buffer_size(buffers));
+    const auto off(out_.size());
+    out_.resize(off + bytes);
+    asio::buffer_copy(asio::buffer(out_.data() + off, bytes), buffers);
+    cond_.notify_all();
+
+    post(op, bs::error_code(), bytes);
+}
+
+template <typename MutableBufferSequence, typename Handler>
+void Transport::async_read_some(const MutableBufferSequence &buffers
+                                , Handler &&handler)
+{
+    if (!pipe_) {
+        socket_.async_read_some(buffers, std::forward<Handler>(handler));
+        return;
+    }
+    pipe_->serverRead(buffers, std::forward<Handler>(handler));
+}
+
+template <typename ConstBufferSequence, typename Handler>
+void Transport::async_write_some(const ConstBufferSequence &buffers
+                                 , Handler &&handler)
+{
+    if (!pipe_) {
+        socket_.async_write_some(buffers, std::forward<Handler>(handler));
+        return;
+    }
+    pipe_->serverWrite(buffers, std::forward<Handler>(handler));
+}
+
+} } // namespace http::detail
+
+#endif // http_detail_transport_hpp_included_
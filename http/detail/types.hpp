@@ -26,11 +26,15 @@
 #ifndef http_detail_types_hpp_included_
 #define http_detail_types_hpp_included_
 
+#include <ctime>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "utility/enum-io.hpp"
+#include "utility/httpcode.hpp"
 
 #include "../request.hpp"
 
@@ -48,6 +52,32 @@ struct Request : http::Request {
     enum class State { reading, ready, broken };
     State state;
 
+    typedef std::chrono::steady_clock Clock;
+
+    /** Time when request line has been read.
+     */
+    Clock::time_point received;
+
+    /** Wall clock time when request line has been read.
+     */
+    std::chrono::system_clock::time_point receivedAt;
+
+    /** Time when request headers have been read.
+     */
+    Clock::time_point parsed;
+
+    /** Time when request has been handed over to content generator.
+     */
+    Clock::time_point dispatched;
+
+    /** Time when content generator has handed response over to the sink.
+     */
+    Clock::time_point responding;
+
+    /** Trace id, zero if request is not traced.
+     */
+    std::uint64_t traceId;
+
     typedef std::vector<Request> list;
 
     Request() { clear(); }
@@ -60,10 +90,13 @@ struct Request : http::Request {
         uri.clear();
         path.clear();
         query.clear();
+        resetParams();
         version = "HTTP/1.1";
         headers.clear();
+        indexHeaders();
         lines = 0;
         state = State::reading;
+        traceId = 0;
     }
 };
 
@@ -32,11 +32,14 @@
 #endif
 
 #include <ctime>
+#include <cstdio>
+#include <cstring>
 #include <algorithm>
 #include <atomic>
 #include <thread>
 #include <condition_variable>
 #include <memory>
+#include <random>
 
 #include <boost/noncopyable.hpp>
 #include <boost/asio.hpp>
@@ -57,6 +60,8 @@
 #include "detail/serverconnection.hpp"
 #include "detail/acceptor.hpp"
 #include "detail/httpdate.hpp"
+#include "detail/headers.hpp"
+#include "detail/parser.hpp"
 #include "asio.hpp"
 
 namespace ba = boost::algorithm;
@@ -118,12 +123,12 @@ std::atomic<std::size_t> ServerConnection::idGenerator_(0);
 
 Http::Detail::Detail()
     : work_(std::ref(ios_))
-    , dnsCache_(ios_)
     , running_(false)
     , serverHeader_("httpd/unknown")
+    , serverTiming_(false)
+    , slowRequestThreshold_(0)
     , connectionCounter_(512)
     , requestCounter_(512)
-    , currentClient_()
 {}
 
 void Http::Detail::startServer(std::size_t count)
@@ -141,10 +146,16 @@ void Http::Detail::startServer(std::size_t count)
         std::function<void()> func;
     } guard([this]() { stop(); });
 
+    latency_.workers(count);
+    handlers_.reset(new std::atomic<std::uint64_t>[count]);
+    for (std::size_t i(0); i < count; ++i) { handlers_[i] = 0; }
+
     for (std::size_t id(1); id <= count; ++id) {
         workers_.emplace_back(&Detail::worker, this, id);
     }
 
+    loopMonitor_.add("server", ios_);
+
     guard.release();
     running_ = true;
 }
@@ -153,25 +164,59 @@ void Http::Detail::startServer(std::size_t count)
 void Http::Detail::startClient(std::size_t count,
                                const ContentFetcher::Options *options)
 {
-    if (!clients_.empty()) {
+    std::unique_lock<std::mutex> lock(clientMutex_);
+    if (std::atomic_load(&dispatcher_)) {
         LOGTHROW(err3, Error)
             << "HTTP client-side machinery is already running.";
     }
 
+    // DNS and TLS session caches shared by all clients
+    const auto share(detail::CurlShare::create(options));
+
+    // our own resolver cache
+    const ContentFetcher::Options defaults;
+    const auto &o(options ? *options : defaults);
+    detail::DnsCache *dnsCache(nullptr);
+    if (o.dnsCacheTtl > 0) {
+        dnsCache_.ttl(std::chrono::seconds(o.dnsCacheTtl)
+                      , std::chrono::seconds
+                      (std::max(o.dnsCacheNegativeTtl, 0l)));
+        dnsCache = &dnsCache_;
+    }
+
+    detail::CurlClient::list clients;
     for (int id(1); id <= int(count); ++id) {
-        clients_.push_back(std::make_shared<detail::CurlClient>(id, options));
+        clients.push_back(std::make_shared<detail::CurlClient>
+                          (id, options, &metrics_, &tracer_, share
+                           , dnsCache));
+        loopMonitor_.add(str(boost::format("client%d") % id)
+                         , clients.back()->ioService());
+    }
+
+    if (!clients.empty()) {
+        std::atomic_store(&dispatcher_, std::make_shared<detail::Dispatcher>
+                          (clients, options, &metrics_));
     }
-    currentClient_ = clients_.begin();
 }
 
 void Http::Detail::stop()
 {
     LOG(info2) << "Stopping HTTP.";
 
+    // no more probes
+    loopMonitor_.stop();
+
     // client side first (client can handle subrequest received by server)
     {
         std::unique_lock<std::mutex> lock(clientMutex_);
-        clients_.clear();
+        auto dispatcher(std::atomic_exchange
+                        (&dispatcher_, detail::Dispatcher::pointer()));
+
+        // wait for running fetches to let go; clients must be destroyed
+        // here, never in a fetching (possibly client's own) thread
+        while (dispatcher && (dispatcher.use_count() > 1)) {
+            std::this_thread::yield();
+        }
     }
 
     // server side second;
@@ -218,6 +263,27 @@ void Http::Detail::stop()
     running_ = false;
 }
 
+void Http::Detail::accessLog(const std::string &path, std::size_t capacity)
+{
+    if (running_) {
+        LOGTHROW(err3, Error)
+            << "Access log must be configured before server is started.";
+    }
+
+    accessLog_.reset();
+    accessLog_.reset(new detail::AccessLog(path, capacity));
+}
+
+void Http::Detail::latencyRoutes(const std::vector<std::string> &prefixes)
+{
+    if (running_) {
+        LOGTHROW(err3, Error)
+            << "Latency routes must be configured before server is started.";
+    }
+
+    latency_.routes(prefixes);
+}
+
 utility::TcpEndpoint
 Http::Detail::listen(const utility::TcpEndpoint &listen
                      , const ContentGenerator::pointer &contentGenerator)
@@ -230,14 +296,33 @@ Http::Detail::listen(const utility::TcpEndpoint &listen
     return acceptors_.back()->localEndpoint();
 }
 
+MemoryStream::pointer
+Http::Detail::connect(const ContentGenerator::pointer &contentGenerator)
+{
+    auto pipe(std::make_shared<detail::MemoryPipe>(ios_));
+    auto conn(std::make_shared<detail::ServerConnection>
+              (*this, ios_, contentGenerator));
+    conn->pipe(pipe);
+
+    addServerConnection(conn);
+    conn->start();
+    return pipe;
+}
+
 void Http::Detail::worker(std::size_t id)
 {
     dbglog::thread_id(str(boost::format("shttp:%u") % id));
     LOG(info2) << "Spawned HTTP server worker id:" << id << ".";
+    latency_.bind(id - 1);
 
+    auto &handlers(handlers_[id - 1]);
     for (;;) {
         try {
-            ios_.run();
+            // run handlers one by one to count them
+            while (ios_.run_one()) {
+                handlers.store(handlers.load(std::memory_order_relaxed) + 1
+                               , std::memory_order_relaxed);
+            }
             LOG(info2) << "Terminated HTTP server worker id:" << id << ".";
             return;
         } catch (const std::exception &e) {
@@ -252,6 +337,7 @@ void Http::Detail
 ::addServerConnection(const detail::ServerConnection::pointer &conn)
 {
     connectionCounter_.event();
+    metrics_.add(detail::Metrics::Counter::connectionsAccepted);
     std::unique_lock<std::mutex> lock(connMutex_);
     connections_.insert(conn);
 }
@@ -263,6 +349,7 @@ void Http::Detail
         std::unique_lock<std::mutex> lock(connMutex_);
         connections_.erase(conn);
     }
+    metrics_.add(detail::Metrics::Counter::connectionsClosed);
     connCond_.notify_one();
 }
 
@@ -306,13 +393,25 @@ void Acceptor::stop(const StoppedHandler &done)
     });
 }
 
+/** Formats duration as milliseconds with microsecond precision.
+ */
+std::string milliseconds(Request::Clock::duration d)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3f"
+                  , std::chrono::duration<double, std::milli>(d).count());
+    return buf;
+}
+
 void prelogAndProcess(Http::Detail &detail
                       , const ServerConnection::pointer &connection
                       , const Request &request)
 {
-    LOG(info2, connection->lm())
-        << "HTTP \"" << request.method << ' ' << request.uri
-        << ' ' << request.version << "\".";
+    if (!connection->accessLog()) {
+        LOG(info2, connection->lm())
+            << "HTTP \"" << request.method << ' ' << request.uri
+            << ' ' << request.version << "\".";
+    }
     detail.request(connection, request);
 }
 
@@ -322,6 +421,74 @@ void postLog(const ServerConnection::pointer &connection
 {
     connection->countRequest();
 
+    auto &metrics(connection->metrics());
+    connection->finishRequest();
+    metrics.response(response.numericCode());
+
+    if (request.received != Request::Clock::time_point()) {
+        const auto us([](Request::Clock::duration d) -> std::uint64_t
+        {
+            const auto value(std::chrono::duration_cast
+                             <std::chrono::microseconds>(d).count());
+            return (value < 0) ? 0 : value;
+        });
+
+        const auto now(Request::Clock::now());
+        const auto started(connection->responseStarted());
+
+        LatencyStats::Sample sample;
+        typedef LatencyStats::Stage Stage;
+        sample[Stage::parse] = us(request.parsed - request.received);
+        sample[Stage::generate] = us(started - request.dispatched);
+        sample[Stage::ttfb] = us(started - request.received);
+        sample[Stage::write] = us(now - started);
+        connection->latency().record(request.path, response.numericCode()
+                                     , sample);
+    }
+
+    const auto slow(connection->slowRequestThreshold());
+    if ((slow > 0) && (request.received != Request::Clock::time_point())) {
+        const auto now(Request::Clock::now());
+        if ((now - request.received) > std::chrono::milliseconds(slow)) {
+            const auto started(connection->responseStarted());
+            const auto responding
+                ((request.responding != Request::Clock::time_point())
+                 ? request.responding : started);
+
+            LOG(warn2, connection->lm())
+                << "Slow request \"" << request.method << ' ' << request.uri
+                << "\" " << response.numericCode() << ": total "
+                << milliseconds(now - request.received) << " ms (parse "
+                << milliseconds(request.parsed - request.received)
+                << ", queue "
+                << milliseconds(request.dispatched - request.parsed)
+                << ", generate "
+                << milliseconds(responding - request.dispatched)
+                << ", serialize " << milliseconds(started - responding)
+                << ", write " << milliseconds(now - started) << ").";
+        }
+    }
+
+    if (request.traceId) {
+        const auto now(Request::Clock::now());
+        const auto started(connection->responseStarted());
+        auto &tracer(connection->tracer());
+        const auto id(request.traceId);
+
+        tracer.span("request", id, request.received, now
+                    , request.method + ' ' + request.uri);
+        tracer.span("parse", id, request.received, request.parsed);
+        tracer.span("queue", id, request.parsed, request.dispatched);
+        tracer.span("generate", id, request.dispatched, started);
+        tracer.span("respond", id, started, now);
+    }
+
+    if (auto *accessLog = connection->accessLog()) {
+        // formatted off the IO thread
+        accessLog->push(connection->id(), request, response, size);
+        return;
+    }
+
     if (response.code == StatusCode::OK) {
         LOG(info3, connection->lm())
             << "HTTP \"" << request.method << ' ' << request.uri
@@ -384,7 +551,14 @@ void ServerConnection::process()
     switch (requests_.front().state) {
     case Request::State::ready:
         state_ = State::busy;
-        prelogAndProcess(owner_, shared_from_this(), pop());
+        {
+            auto request(pop());
+            request.dispatched = Request::Clock::now();
+            traceId_ = request.traceId;
+            metrics().add(Metrics::Counter::requestsDispatched);
+            inFlight_ = true;
+            prelogAndProcess(owner_, shared_from_this(), request);
+        }
         break;
 
     case Request::State::broken:
@@ -424,11 +598,12 @@ void ServerConnection::close(const bs::error_code &ec)
     } else {
         LOG(err2, lm_) << "Error: " << ec;
         bs::error_code cec;
-        socket_.close(cec);
+        transport_.close(cec);
     }
 
     // aborted
     state_ = State::closed;
+    finishRequest();
     aborted();
     owner_.removeServerConnection(shared_from_this());
 }
@@ -438,8 +613,11 @@ void ServerConnection::close()
     if (state_ != State::closed) {
         LOG(info2, lm_) << "ServerConnection closed.";
         bs::error_code cec;
-        socket_.close(cec);
+        transport_.close(cec);
     }
+
+    // request (if any) ends with the connection
+    finishRequest();
 }
 
 void ServerConnection::closeConnection()
@@ -484,6 +662,7 @@ void ServerConnection::readRequest()
         }
 
         ++request.lines;
+        metrics().add(Metrics::Counter::bytesIn, bytes);
 
         if (bytes == 2) {
             // empty line -> restart request parsing
@@ -492,37 +671,27 @@ void ServerConnection::readRequest()
             return;
         }
 
-        std::istream is(&requestData_);
-        is.unsetf(std::ios_base::skipws);
-        if (!(is >> request.method >> utility::expect(' ')
-              >> request.uri >> utility::expect(' ')
-              >> request.version
-              >> utility::expect('\r') >> utility::expect('\n')))
-        {
+        request.received = Request::Clock::now();
+        request.receivedAt = std::chrono::system_clock::now();
+        request.traceId = owner_.tracer().sample();
+
+        // parse line in place, NB: buffer is contiguous
+        const auto ok(parseRequestLine
+                      (request, asio::buffer_cast<const char*>
+                       (requestData_.data()), bytes));
+        requestData_.consume(bytes);
+
+        if (!ok) {
             request.makeBroken();
             process();
             return;
         }
 
-        // process uri
-        {
-            auto qm(request.uri.find('?'));
-            if (qm != std::string::npos) {
-                request.path = utility::Uri::removeDotSegments
-                    (utility::urlDecode(request.uri.substr(0, qm)));
-                request.query = request.uri.substr(qm + 1);
-            } else {
-                request.path = utility::Uri::removeDotSegments
-                    (utility::urlDecode(request.uri));
-                request.query.clear();
-            }
-        }
-
         readHeader(self);
     });
 
     requests_.back().clear();
-    asio::async_read_until(socket_, requestData_, "\r\n"
+    asio::async_read_until(transport_, requestData_, "\r\n"
                            , strand_.wrap(parseRequest));
 }
 
@@ -541,10 +710,13 @@ void ServerConnection::readHeader(const pointer &self)
         }
 
         ++request.lines;
+        metrics().add(Metrics::Counter::bytesIn, bytes);
 
         if (bytes == 2) {
             // empty line -> restart request parsing
             requestData_.consume(bytes);
+            request.indexHeaders();
+            request.parsed = Request::Clock::now();
             request.makeReady();
 
             // try to process immediately
@@ -555,51 +727,22 @@ void ServerConnection::readHeader(const pointer &self)
             return;
         }
 
-        std::istream is(&requestData_);
-        if (std::isspace(is.peek())) {
-            // previous header line continuation
-            if (request.headers.empty()) {
-                request.makeBroken();
-                process();
-                return;
-            }
-
-            // read rest of line into temporary
-            std::string tmp;
-            if (!std::getline(is, tmp, '\r')) {
-                request.makeBroken();
-                process();
-                return;
-            }
-            // append to previus line
-            request.headers.back().value.append(tmp);
-
-            // eat '\n'
-            is.get();
-            readHeader(self);
-            return;
-        }
-
-        request.headers.emplace_back();
-        auto &header(request.headers.back());
+        // parse line in place, NB: buffer is contiguous
+        const auto ok(parseHeaderLine
+                      (request, asio::buffer_cast<const char*>
+                       (requestData_.data()), bytes));
+        requestData_.consume(bytes);
 
-        if (!std::getline(is, header.name, ':')) {
-            request.makeBroken();
-            process();
-            return;
-        }
-        if (!std::getline(is, header.value, '\r')) {
+        if (!ok) {
             request.makeBroken();
             process();
             return;
         }
-        // eat '\n'
-        is.get();
 
         readHeader(self);
     });
 
-    asio::async_read_until(socket_, requestData_, "\r\n"
+    asio::async_read_until(transport_, requestData_, "\r\n"
                            , strand_.wrap(parseHeader));
 }
 
@@ -619,22 +762,59 @@ void ServerConnection::badRequest()
     sendResponse({}, response, error400, true);
 }
 
+void ServerConnection::writeHeader(std::ostream &os, const Request &request
+                                   , const Response &response)
+{
+    responseStarted_ = Request::Clock::now();
+
+    writeResponseHeader(os, request.version, response, owner_.serverHeader());
+
+    if (owner_.serverTiming()
+        && (request.dispatched != Request::Clock::time_point()))
+    {
+        // response may be generated without a sink (e.g. batch)
+        const auto responding
+            ((request.responding != Request::Clock::time_point())
+             ? request.responding : responseStarted_);
+
+        os << "Server-Timing: queue;dur="
+           << milliseconds(request.dispatched - request.parsed)
+           << ", gen;dur=" << milliseconds(responding - request.dispatched)
+           << ", ser;dur=" << milliseconds(responseStarted_ - responding)
+           << "\r\n";
+    }
+}
+
+void ServerConnection::responseSent(const Request &request
+                                    , const Response &response
+                                    , const bs::error_code &ec
+                                    , std::size_t bytes)
+{
+    if (ec) {
+        close(ec);
+        return;
+    }
+
+    // eat data from response
+    responseData_.consume(bytes);
+
+    // log what happened
+    postLog(shared_from_this(), request, response, bytes);
+
+    // response sent, not busy for now
+    makeReady();
+
+    // we are not busy so try next request immediately
+    process();
+}
+
 void ServerConnection::sendResponse(const Request &request
                                     , const Response &response
                                     , const void *data, const size_t size
                                     , bool persistent)
 {
     std::ostream os(&responseData_);
-
-    os << request.version << ' ' << response.numericCode() << ' '
-       << utility::httpCodeCategory().message(static_cast<int>(response.code))
-       << "\r\n";
-
-    os << "Date: " << formatHttpDate(-1) << "\r\n";
-    os << "Server: " << owner_.serverHeader() << "\r\n";
-    for (const auto &hdr : response.headers) {
-        os << hdr.name << ": "  << hdr.value << "\r\n";
-    }
+    writeHeader(os, request, response);
 
     // optional data
     if (data) {
@@ -661,25 +841,10 @@ void ServerConnection::sendResponse(const Request &request
     }
 
     auto self(shared_from_this());
-    auto responseSent([self, this, request, response]
-                      (const bs::error_code &ec, std::size_t bytes)
+    auto sent([self, this, request, response]
+              (const bs::error_code &ec, std::size_t bytes)
     {
-        if (ec) {
-            close(ec);
-            return;
-        }
-
-        // eat data from response
-        responseData_.consume(bytes);
-
-        // log what happened
-        postLog(self, request, response, bytes);
-
-        // response sent, not busy for now
-        makeReady();
-
-        // we are not busy so try next request immediately
-        process();
+        responseSent(request, response, ec, bytes);
     });
 
     if (persistent && data) {
@@ -688,12 +853,51 @@ void ServerConnection::sendResponse(const Request &request
             , asio::const_buffer(data, size)
         };
 
-        asio::async_write(socket_, buffers
-                          , strand_.wrap(responseSent));
+        write(buffers, sent);
     } else {
-        asio::async_write(socket_, responseData_.data()
-                          , strand_.wrap(responseSent));
+        write(responseData_.data(), sent);
+    }
+}
+
+void ServerConnection::sendResponse(const Request &request
+                                    , const Response &response
+                                    , const SinkBase::Fragment::list
+                                    &fragments)
+{
+    std::ostream os(&responseData_);
+    writeHeader(os, request, response);
+
+    os << "Content-Length: " << SinkBase::Fragment::totalSize(fragments)
+       << "\r\n";
+    if (response.close) { os << "Connection: close\r\n"; }
+
+    os << "\r\n";
+
+    // mark as busy/close
+    if (response.close) {
+        state_ = State::busyClose;
+    }
+
+    // NB: fragments are captured to keep owned data alive until sent
+    auto self(shared_from_this());
+    auto sent([self, this, request, response, fragments]
+              (const bs::error_code &ec, std::size_t bytes)
+    {
+        responseSent(request, response, ec, bytes);
+    });
+
+    std::vector<asio::const_buffer> buffers = { responseData_.data() };
+    if (request.method != "HEAD") {
+        // not a HEAD request -> gather all non-empty fragments
+        buffers.reserve(fragments.size() + 1);
+        for (const auto &fragment : fragments) {
+            if (fragment.size) {
+                buffers.emplace_back(fragment.data, fragment.size);
+            }
+        }
     }
+
+    write(buffers, sent);
 }
 
 inline bool buildCacheControlLine(std::ostream &os
@@ -739,16 +943,7 @@ void ServerConnection
                , const SinkBase::DataSource::pointer &source)
 {
     std::ostream os(&responseData_);
-
-    os << request.version << ' ' << response.numericCode() << ' '
-       << utility::httpCodeCategory().message(static_cast<int>(response.code))
-       << "\r\n";
-
-    os << "Date: " << formatHttpDate(-1) << "\r\n";
-    os << "Server: " << owner_.serverHeader() << "\r\n";
-    for (const auto &hdr : response.headers) {
-        os << hdr.name << ": "  << hdr.value << "\r\n";
-    }
+    writeHeader(os, request, response);
 
     // size
     auto stat(source->stat());
@@ -782,26 +977,10 @@ void ServerConnection
                          (const bs::error_code &ec
                           , std::size_t bytes)
         {
-            if (ec) {
-                close(ec);
-                return;
-            }
-
-            // consume header data
-            responseData_.consume(bytes);
-
-            // log what happened
-            postLog(self, request, response, bytes);
-
-            // response sent, not busy for now
-            makeReady();
-
-            // we are not busy so try next request immediately
-            process();
+            responseSent(request, response, ec, bytes);
         });
 
-        asio::async_write(socket_, responseData_.data()
-                          , strand_.wrap(headersSent));
+        write(responseData_.data(), headersSent);
         return;
     }
 
@@ -819,14 +998,13 @@ void ServerConnection
 
         void start() {
             auto self(shared_from_this());
-            asio::async_write
-                (conn->socket_, conn->responseData_.data()
-                 , conn->strand_.wrap
-                 ([self, this](const bs::error_code &ec
-                               , std::size_t bytes)
+            conn->write
+                (conn->responseData_.data()
+                 , [self, this](const bs::error_code &ec
+                                , std::size_t bytes)
             {
                 headersSent(ec, bytes);
-            }));
+            });
         }
 
         void headersSent(const bs::error_code &ec
@@ -852,7 +1030,10 @@ void ServerConnection
 
             std::size_t s(0);
             try {
+                const auto start(Tracer::Clock::now());
                 s = source->read(buf.data(), buf.size(), off);
+                conn->tracer().span("source.read", request.traceId
+                                    , start, Tracer::Clock::now());
             } catch (const std::exception &e) {
                 // force close
                 LOG(err2) << "Error while reading from data source \""
@@ -865,14 +1046,12 @@ void ServerConnection
 
             // handle chunking
             if (chunked) {
-                std::ostringstream os;
-                os << std::hex << s << crlf;
+                chunk = chunkHeader(s);
                 if (!s) {
                     // last chunk
                     bytesLeft = 0;
-                    os << crlf;
+                    chunk += crlf;
                 }
-                chunk = os.str();
             } else {
                 bytesLeft -= long(s);
             }
@@ -883,16 +1062,14 @@ void ServerConnection
             if (chunked) {
                 if (!s) {
                     // empty chunk
-                    asio::async_write
-                        (conn->socket_
-                         , asio::const_buffers_1(chunk.data()
-                                                 , chunk.size())
-                         , conn->strand_.wrap
-                         ([self, this](const bs::error_code &ec
-                                       , std::size_t bytes)
+                    conn->write
+                        (asio::const_buffers_1(chunk.data()
+                                               , chunk.size())
+                         , [self, this](const bs::error_code &ec
+                                        , std::size_t bytes)
                           {
                               bodySent(ec, bytes);
-                          }));
+                          });
                     return;
                 }
 
@@ -908,25 +1085,23 @@ void ServerConnection
                     (asio::const_buffer(crlf.data(), crlf.size()));
 
                 // send all buffers at once
-                asio::async_write
-                    (conn->socket_, buffers
-                     , conn->strand_.wrap
-                     ([self, this](const bs::error_code &ec
-                                   , std::size_t bytes)
+                conn->write
+                    (buffers
+                     , [self, this](const bs::error_code &ec
+                                    , std::size_t bytes)
                       {
                           bodySent(ec, bytes);
-                      }));
+                      });
             } else {
                 // non-chunked
                 LOG(info1) << "Sending non-chunked.";
-                asio::async_write
-                    (conn->socket_, asio::const_buffers_1(buf.data(), s)
-                     , conn->strand_.wrap
-                     ([self, this](const bs::error_code &ec
-                                   , std::size_t bytes)
+                conn->write
+                    (asio::const_buffers_1(buf.data(), s)
+                     , [self, this](const bs::error_code &ec
+                                    , std::size_t bytes)
                       {
                           bodySent(ec, bytes);
-                      }));
+                      });
             }
 
             return;
@@ -973,6 +1148,216 @@ void ServerConnection
                              , source, dataSize)->start();
 }
 
+ChunkedWriter::pointer
+ServerConnection::sendChunked(const Request &request
+                              , const Response &response)
+{
+    std::ostream os(&responseData_);
+    writeHeader(os, request, response);
+
+    os << "Transfer-Encoding: chunked\r\n";
+    if (response.close) { os << "Connection: close\r\n"; }
+
+    os << "\r\n";
+
+    // mark as busy/close
+    if (response.close) {
+        state_ = State::busyClose;
+    }
+
+    auto writer(std::make_shared<ChunkedWriter>
+                (shared_from_this(), request, response));
+    writer->start();
+    return writer;
+}
+
+void ChunkedWriter::start()
+{
+    auto self(shared_from_this());
+    conn_->write(conn_->responseData_.data()
+                 , [self, this](const bs::error_code &ec
+                                , std::size_t bytes)
+    {
+        // consume header data
+        if (!ec) { conn_->responseData_.consume(bytes); }
+        sent(ec, bytes);
+    });
+}
+
+void ChunkedWriter::write(SinkBase::Fragment::list &&fragments)
+{
+    // NB: lambda cannot capture by move
+    auto chunk(std::make_shared<SinkBase::Fragment::list>
+               (std::move(fragments)));
+
+    auto self(shared_from_this());
+    conn_->strand_.post([self, this, chunk]()
+    {
+        queue_.push_back(std::move(*chunk));
+        flush();
+    });
+}
+
+void ChunkedWriter::finish()
+{
+    auto self(shared_from_this());
+    conn_->strand_.post([self, this]()
+    {
+        finished_ = true;
+        flush();
+    });
+}
+
+void ChunkedWriter::flush()
+{
+    if (writing_ || terminated_
+        || (conn_->state_ == ServerConnection::State::closed))
+    {
+        // busy, done or connection is gone
+        return;
+    }
+
+    // move all pending non-empty chunks in flight, generate chunk headers
+    while (!queue_.empty()) {
+        auto &chunk(queue_.front());
+        if (const auto size = SinkBase::Fragment::totalSize(chunk)) {
+            framing_.push_back(chunkHeader(size));
+            inflight_.push_back(std::move(chunk));
+        }
+        queue_.pop_front();
+    }
+
+    if (finished_) {
+        // last chunk
+        framing_.push_back("0\r\n\r\n");
+        terminated_ = true;
+    } else if (inflight_.empty()) {
+        // nothing to send
+        return;
+    }
+
+    static const std::string crlf("\r\n");
+
+    // NB: buffers are built after all framing is in place
+    std::vector<asio::const_buffer> buffers;
+    auto iframing(framing_.begin());
+    for (const auto &chunk : inflight_) {
+        buffers.emplace_back(iframing->data(), iframing->size());
+        ++iframing;
+        for (const auto &fragment : chunk) {
+            if (fragment.size) {
+                buffers.emplace_back(fragment.data, fragment.size);
+            }
+        }
+        buffers.emplace_back(crlf.data(), crlf.size());
+    }
+    if (iframing != framing_.end()) {
+        buffers.emplace_back(iframing->data(), iframing->size());
+    }
+
+    writing_ = true;
+    auto self(shared_from_this());
+    conn_->write(buffers
+                 , [self, this](const bs::error_code &ec
+                                , std::size_t bytes)
+    {
+        sent(ec, bytes);
+    });
+}
+
+void ChunkedWriter::sent(const bs::error_code &ec, std::size_t bytes)
+{
+    writing_ = false;
+    inflight_.clear();
+    framing_.clear();
+
+    if (ec) {
+        conn_->close(ec);
+        return;
+    }
+
+    total_ += bytes;
+
+    if (terminated_) {
+        // log what happened
+        postLog(conn_, request_, response_, total_);
+        // response sent, not busy for now
+        conn_->makeReady();
+        // we are not busy so try next request immediately
+        conn_->process();
+        return;
+    }
+
+    flush();
+}
+
+std::string formatListing(const std::string &path
+                          , const ServerSink::Listing &list
+                          , const std::string &header
+                          , const std::string &footer)
+{
+    std::ostringstream os;
+    os << "<html>\n<head><title>Index of " << path
+       << "</title></head>\n<body bgcolor=\"white\">\n"
+       << "<h1>Index of " << path << "\n";
+    if (!header.empty()) { os << header << '\n'; }
+    os << "</h1><hr><pre><a href=\"../\">../</a>\n";
+
+    auto sorted(list);
+    std::sort(sorted.begin(), sorted.end());
+
+    for (const auto &item : sorted) {
+        switch (item.type) {
+        case ServerSink::ListingItem::Type::file:
+            os << "<a href=\"" << item.name << "\">"
+               << item.name << "</a>\n";
+            break;
+        case ServerSink::ListingItem::Type::dir:
+            os << "<a href=\"" << item.name << "/\">"
+               << item.name << "/</a>\n";
+            break;
+        }
+    }
+
+    os << "</pre><hr>\n";
+    if (!footer.empty()) { os << footer << '\n'; }
+    os << "</body>\n</html>\n";
+
+    return os.str();
+}
+
+typedef std::pair<StatusCode, std::string> ErrorStatus;
+
+/** Translates error code to HTTP status code and message.
+ */
+ErrorStatus errorStatus(const std::error_code &ec, const std::string &message)
+{
+    // is it HTTP code?
+    if (ec.category() != utility::httpCodeCategory()) {
+        return ErrorStatus(StatusCode::InternalServerError, message);
+    }
+
+    return ErrorStatus(static_cast<StatusCode>(ec.value())
+                       , message.empty() ? ec.message() : message);
+}
+
+/** Translates exception to HTTP status code and message.
+ */
+ErrorStatus errorStatus(const std::exception_ptr &exc)
+{
+    try {
+        std::rethrow_exception(exc);
+    } catch (const utility::HttpError &e) {
+        return ErrorStatus(static_cast<StatusCode>(e.code().value())
+                           , e.what());
+    } catch (const std::invalid_argument &e) {
+        return ErrorStatus(StatusCode::UnprocessableEntity, e.what());
+    } catch (const std::exception &e) {
+        return ErrorStatus(StatusCode::InternalServerError, e.what());
+    } catch (...) {}
+    return ErrorStatus(StatusCode::InternalServerError, "Unknown");
+}
+
 class HttpSink : public ServerSink {
 public:
     HttpSink(const Request &request
@@ -994,15 +1379,18 @@ private:
     template <typename ...Args>
     inline void sendResponse(Args &&...args)
     {
+        const auto start(Tracer::Clock::now());
         connection_->sendResponse(std::forward<Args>(args)...);
         responseSent_ = true;
+        connection_->tracer().span("sink.respond", request_.traceId
+                                   , start, Tracer::Clock::now());
     }
 
     virtual void content_impl(const void *data, std::size_t size
                               , const FileInfo &stat, bool needCopy
                               , const Header::list *headers)
     {
-        if (!valid()) { return; }
+        if (!start()) { return; }
 
         Response response(headers);
         response.headers.emplace_back("Content-Type", stat.contentType);
@@ -1013,9 +1401,24 @@ private:
         sendResponse(request_, response, data, size, !needCopy);
     }
 
+    virtual void gather_impl(const Fragment::list &fragments
+                             , const FileInfo &stat
+                             , const Header::list *headers)
+    {
+        if (!start()) { return; }
+
+        Response response(headers);
+        response.headers.emplace_back("Content-Type", stat.contentType);
+        response.headers.emplace_back
+            ("Last-Modified", formatHttpDate(stat.lastModified));
+
+        addCacheControl(response, stat.cacheControl);
+        sendResponse(request_, response, fragments);
+    }
+
     virtual void content_impl(const SinkBase::DataSource::pointer &source)
     {
-        if (!valid()) { return; }
+        if (!start()) { return; }
 
         Response response(source->headers());
         sendResponse(request_, response, source);
@@ -1024,7 +1427,7 @@ private:
     virtual void redirect_impl(const std::string &url, utility::HttpCode code
                                , const CacheControl &cacheControl)
     {
-        if (!valid()) { return; }
+        if (!start()) { return; }
 
         Response response(code);
         response.headers.emplace_back("Location", url);
@@ -1036,38 +1439,10 @@ private:
                               , const std::string &footer
                               , const Header::list *headers)
     {
-        if (!valid()) { return; }
-
-        std::string path(request_.path);
-
-        std::ostringstream os;
-        os << "<html>\n<head><title>Index of " << path
-           << "</title></head>\n<body bgcolor=\"white\">\n"
-           << "<h1>Index of " << path << "\n";
-        if (!header.empty()) { os << header << '\n'; }
-        os << "</h1><hr><pre><a href=\"../\">../</a>\n";
+        if (!start()) { return; }
 
-        auto sorted(list);
-        std::sort(sorted.begin(), sorted.end());
-
-        for (const auto &item : sorted) {
-            switch (item.type) {
-            case ServerSink::ListingItem::Type::file:
-                os << "<a href=\"" << item.name << "\">"
-                   << item.name << "</a>\n";
-                break;
-            case ServerSink::ListingItem::Type::dir:
-                os << "<a href=\"" << item.name << "/\">"
-                   << item.name << "/</a>\n";
-                break;
-            }
-        }
-
-        os << "</pre><hr>\n";
-        if (!footer.empty()) { os << footer << '\n'; }
-        os << "</body>\n</html>\n";
-
-        content(os.str(), { "text/html; charset=utf-8", -1, -1 }, headers);
+        content(formatListing(request_.path, list, header, footer)
+                , { "text/html; charset=utf-8", -1, -1 }, headers);
     }
 
     void errorCode(utility::HttpCode code, const std::string &message)
@@ -1141,40 +1516,33 @@ private:
     virtual void error_impl(const std::error_code &ec
                             , const std::string &message)
     {
-        if (!valid()) { return; }
+        if (!start()) { return; }
 
-        // is it HTTP code?
-        if (ec.category() != utility::httpCodeCategory()) {
-            errorCode(utility::HttpCode::InternalServerError, message);
-            return;
-        }
-
-        errorCode(static_cast<utility::HttpCode>(ec.value())
-                  , message.empty() ? ec.message() : message);
+        const auto status(errorStatus(ec, message));
+        errorCode(status.first, status.second);
     }
 
     virtual void error_impl(const std::exception_ptr &exc)
     {
-        if (!valid()) { return; }
+        if (!start()) { return; }
 
-        try {
-            std::rethrow_exception(exc);
-        } catch (const utility::HttpError &e) {
-            errorCode(static_cast<utility::HttpCode>(e.code().value())
-                      , e.what());
-        } catch (const std::invalid_argument &e) {
-            errorCode(StatusCode::UnprocessableEntity, e.what());
-        } catch (const std::exception &e) {
-            errorCode(StatusCode::InternalServerError, e.what());
-        } catch (...) {
-            errorCode(StatusCode::InternalServerError, "Unknown");
-        }
+        const auto status(errorStatus(exc));
+        errorCode(status.first, status.second);
     }
 
     virtual bool checkAborted_impl() const {
         return connection_->finished();
     }
 
+    /** Marks time when generator has handed response over to this sink.
+     */
+    bool start() {
+        if (request_.responding == Request::Clock::time_point()) {
+            request_.responding = Request::Clock::now();
+        }
+        return valid();
+    }
+
     bool valid() const {
         if (responseSent_) {
             LOG(warn2) << "An attempt to send a reply to the client after "
@@ -1194,11 +1562,362 @@ private:
     bool responseSent_;
 };
 
+/** Batch request. Content generator is run once per each resource listed in
+ *  the batch request, generated responses are streamed back in one chunked
+ *  multipart/mixed response as each part is finished.
+ *
+ *  Each part is an application/http message, i.e. complete HTTP response
+ *  (status line, headers, body).
+ */
+class Batch : public std::enable_shared_from_this<Batch> {
+public:
+    typedef std::shared_ptr<Batch> pointer;
+
+    Batch(const ServerConnection::pointer &connection, std::size_t parts)
+        : connection_(connection), left_(parts), boundary_(makeBoundary())
+    {}
+
+    /** Runs batch request.
+     */
+    static void run(const ServerConnection::pointer &connection
+                    , const Request &request);
+
+    /** Sends one part. Thread safe.
+     */
+    void part(const Request &request, const Response &response
+              , SinkBase::Fragment::list &&body);
+
+    bool aborted() const { return connection_->finished(); }
+
+    void setAborter(const ServerSink::AbortedCallback &ac);
+
+private:
+    void start(const Request &request);
+
+    void abort();
+
+    static std::string makeBoundary();
+
+    ServerConnection::pointer connection_;
+    ChunkedWriter::pointer writer_;
+    std::atomic<std::size_t> left_;
+    std::string boundary_;
+
+    std::mutex acMutex_;
+    std::vector<ServerSink::AbortedCallback> acs_;
+};
+
+class BatchPartSink : public ServerSink {
+public:
+    BatchPartSink(const Batch::pointer &batch, const Request &request)
+        : batch_(batch), request_(request), responseSent_(false)
+    {}
+
+    ~BatchPartSink() {
+        try {
+            if (!responseSent_) {
+                errorCode(utility::HttpCode::InternalServerError
+                          , "No response sent.");
+            }
+        } catch (...) {}
+    }
+
+private:
+    void send(Response &response, SinkBase::Fragment::list &&body) {
+        batch_->part(request_, response, std::move(body));
+        responseSent_ = true;
+    }
+
+    void contentResponse(Response &response, const FileInfo &stat) {
+        response.headers.emplace_back("Content-Type", stat.contentType);
+        response.headers.emplace_back
+            ("Last-Modified", formatHttpDate(stat.lastModified));
+        addCacheControl(response, stat.cacheControl);
+    }
+
+    virtual void content_impl(const void *data, std::size_t size
+                              , const FileInfo &stat, bool needCopy
+                              , const Header::list *headers)
+    {
+        if (!valid()) { return; }
+
+        Response response(headers);
+        contentResponse(response, stat);
+        send(response, { needCopy ? Fragment::copy(data, size)
+                    : Fragment(data, size) });
+    }
+
+    virtual void gather_impl(const Fragment::list &fragments
+                             , const FileInfo &stat
+                             , const Header::list *headers)
+    {
+        if (!valid()) { return; }
+
+        Response response(headers);
+        contentResponse(response, stat);
+        send(response, Fragment::list(fragments));
+    }
+
+    virtual void content_impl(const SinkBase::DataSource::pointer &source)
+    {
+        if (!valid()) { return; }
+
+        // parts have explicit size -> read whole source into memory
+        std::string data;
+        try {
+            const auto size(source->size());
+            std::vector<char> buf(1 << 16);
+            if (size >= 0) { data.reserve(size); }
+            while (auto read = source->read(buf.data(), buf.size()
+                                            , data.size()))
+            {
+                data.append(buf.data(), read);
+            }
+        } catch (...) {
+            source->close();
+            error_impl(std::current_exception());
+            return;
+        }
+        source->close();
+
+        Response response(source->headers());
+        contentResponse(response, source->stat());
+        send(response, { Fragment::own(std::move(data)) });
+    }
+
+    virtual void redirect_impl(const std::string &url, utility::HttpCode code
+                               , const CacheControl &cacheControl)
+    {
+        if (!valid()) { return; }
+
+        Response response(code);
+        response.headers.emplace_back("Location", url);
+        addCacheControl(response, cacheControl);
+        send(response, {});
+    }
+
+    virtual void listing_impl(const Listing &list, const std::string &header
+                              , const std::string &footer
+                              , const Header::list *headers)
+    {
+        if (!valid()) { return; }
+
+        content(formatListing(request_.path, list, header, footer)
+                , { "text/html; charset=utf-8", -1, -1 }, headers);
+    }
+
+    void errorCode(utility::HttpCode code, const std::string &message)
+    {
+        Response response(code);
+        response.reason = message;
+        if (code == utility::HttpCode::NotModified) {
+            send(response, {});
+            return;
+        }
+
+        response.headers.emplace_back
+            ("Content-Type", "text/plain; charset=utf-8");
+        send(response, { Fragment::own(message + "\n") });
+    }
+
+    virtual void error_impl(const std::error_code &ec
+                            , const std::string &message)
+    {
+        if (!valid()) { return; }
+
+        const auto status(errorStatus(ec, message));
+        errorCode(status.first, status.second);
+    }
+
+    virtual void error_impl(const std::exception_ptr &exc)
+    {
+        if (!valid()) { return; }
+
+        const auto status(errorStatus(exc));
+        errorCode(status.first, status.second);
+    }
+
+    virtual bool checkAborted_impl() const { return batch_->aborted(); }
+
+    bool valid() const {
+        if (responseSent_) {
+            LOG(warn2) << "An attempt to send a reply to the client after "
+                "another response has been already sent. Check your code.";
+            return false;
+        }
+        return !batch_->aborted();
+    }
+
+    virtual void setAborter_impl(const AbortedCallback &ac) {
+        batch_->setAborter(ac);
+    }
+
+    Batch::pointer batch_;
+    Request request_;
+
+    bool responseSent_;
+};
+
+namespace {
+
+/** Maximum number of resources in one batch request.
+ */
+const std::size_t maxBatchSize(1024);
+
+} // namespace
+
+void Batch::run(const ServerConnection::pointer &connection
+                , const Request &request)
+{
+    // query is a list of &-separated url-encoded resource URIs
+    std::vector<Request> parts;
+    for (auto b(request.query.begin()), e(request.query.end()); b != e; ) {
+        auto amp(std::find(b, e, '&'));
+        if (amp != b) {
+            parts.push_back(request);
+            auto &part(parts.back());
+            part.uri = utility::urlDecode(std::string(b, amp));
+            if (std::find_if(part.uri.begin(), part.uri.end()
+                             , [](char c) {
+                                 return std::iscntrl
+                                     (static_cast<unsigned char>(c));
+                             })
+                != part.uri.end())
+            {
+                // control characters are not allowed (header injection)
+                parts.clear();
+                break;
+            }
+            splitUri(part);
+        }
+        b = (amp == e) ? e : std::next(amp);
+    }
+
+    if (parts.empty() || (parts.size() > maxBatchSize)
+        || (request.method != "GET"))
+    {
+        auto sink(std::make_shared<HttpSink>(request, connection));
+        if (request.method != "GET") {
+            sink->error(utility::makeError<NotAllowed>
+                        ("Method %s is not supported by batch."
+                         , request.method));
+        } else {
+            sink->error(utility::makeError<BadRequest>
+                        ("Batch must contain between 1 and %d valid "
+                         "resources.", maxBatchSize));
+        }
+        return;
+    }
+
+    auto batch(std::make_shared<Batch>(connection, parts.size()));
+    batch->start(request);
+
+    auto &generator(*connection->contentGenerator());
+    for (const auto &part : parts) {
+        auto sink(std::make_shared<BatchPartSink>(batch, part));
+        try {
+            generator.generate(part, sink);
+        } catch (...) {
+            sink->error();
+        }
+    }
+}
+
+void Batch::start(const Request &request)
+{
+    Response response(StatusCode::OK);
+    response.headers.emplace_back
+        ("Content-Type", "multipart/mixed; boundary=" + boundary_);
+    response.headers.emplace_back("Cache-Control", "no-cache");
+
+    // forward abort to all parts
+    std::weak_ptr<Batch> weak(shared_from_this());
+    connection_->setAborter([weak]()
+    {
+        if (auto self = weak.lock()) { self->abort(); }
+    });
+
+    writer_ = connection_->sendChunked(request, response);
+}
+
+void Batch::part(const Request &request, const Response &response
+                 , SinkBase::Fragment::list &&body)
+{
+    std::ostringstream os;
+    os << "--" << boundary_ << "\r\n"
+       << "Content-Type: application/http\r\n"
+       << "Content-Location: " << request.uri << "\r\n"
+       << "\r\n";
+
+    // embedded response; NB: HEAD is never sent in batch
+    os << request.version << ' ' << response.numericCode() << ' '
+       << utility::httpCodeCategory().message(response.numericCode())
+       << "\r\n";
+    for (const auto &hdr : response.headers) {
+        os << hdr.name << ": "  << hdr.value << "\r\n";
+    }
+    os << "Content-Length: " << SinkBase::Fragment::totalSize(body)
+       << "\r\n\r\n";
+
+    static const std::string crlf("\r\n");
+
+    SinkBase::Fragment::list chunk;
+    chunk.reserve(body.size() + 2);
+    chunk.push_back(SinkBase::Fragment::own(os.str()));
+    chunk.insert(chunk.end(), body.begin(), body.end());
+    chunk.emplace_back(crlf.data(), crlf.size());
+
+    LOG(info1, connection_->lm())
+        << "Batch part \"" << request.uri << "\" "
+        << response.numericCode() << '.';
+
+    // NB: part must be written before it is counted
+    writer_->write(std::move(chunk));
+
+    if (!--left_) {
+        // last part, send terminating boundary
+        writer_->write({ SinkBase::Fragment::own
+                    ("--" + boundary_ + "--\r\n") });
+        writer_->finish();
+    }
+}
+
+void Batch::setAborter(const ServerSink::AbortedCallback &ac)
+{
+    std::unique_lock<std::mutex> lock(acMutex_);
+    acs_.push_back(ac);
+}
+
+void Batch::abort()
+{
+    // grab current callbacks
+    auto acs([&]() -> std::vector<ServerSink::AbortedCallback>
+    {
+        std::unique_lock<std::mutex> lock(acMutex_);
+        return acs_;
+    }());
+
+    // call them without locking
+    for (const auto &ac : acs) { if (ac) { ac(); } }
+}
+
+std::string Batch::makeBoundary()
+{
+    static thread_local std::mt19937_64 generator(std::random_device{}());
+    return str(boost::format("batch-%016x%016x")
+               % generator() % generator());
+}
+
 } // namespace detail
 
 void Http::Detail::request(const detail::ServerConnection::pointer &connection
                            , const detail::Request &request)
 {
+    if (!batchPath_.empty() && (request.path == batchPath_)) {
+        detail::Batch::run(connection, request);
+        return;
+    }
+
     auto sink(std::make_shared<detail::HttpSink>(request, connection));
     try {
         if ((request.method == "HEAD") || (request.method == "GET")) {
@@ -1239,6 +1958,18 @@ utility::TcpEndpoint Http::listen(const utility::TcpEndpoint &listen
                            (&contentGenerator, [](void*){}));
 }
 
+MemoryStream::pointer
+Http::connect(const ContentGenerator::pointer &contentGenerator)
+{
+    return detail().connect(contentGenerator);
+}
+
+MemoryStream::pointer Http::connect(ContentGenerator &contentGenerator)
+{
+    return detail().connect(ContentGenerator::pointer
+                            (&contentGenerator, [](void*){}));
+}
+
 void Http::startServer(unsigned int threadCount)
 {
     detail().startServer(threadCount);
@@ -1260,12 +1991,165 @@ void Http::serverHeader(const std::string &value)
     detail().serverHeader(value);
 }
 
+void Http::batchPath(const std::string &path)
+{
+    detail().batchPath(path);
+}
+
+void Http::loopMonitor(long interval)
+{
+    detail().loopMonitor(interval);
+}
+
+void Http::serverTiming(bool enable)
+{
+    detail().serverTiming(enable);
+}
+
+void Http::slowRequestLog(long threshold)
+{
+    detail().slowRequestThreshold(threshold);
+}
+
+void Http::accessLog(const std::string &path, std::size_t capacity)
+{
+    detail().accessLog(path, capacity);
+}
+
+void Http::latencyRoutes(const std::vector<std::string> &prefixes)
+{
+    detail().latencyRoutes(prefixes);
+}
+
 ContentFetcher& Http::fetcher() {
     return detail();
 }
 
+namespace {
+
+/** Names of well-known headers, bucketed by name length.
+ */
+class KnownHeaders {
+public:
+    KnownHeaders() {
+        add(KnownHeader::host, "Host");
+        add(KnownHeader::connection, "Connection");
+        add(KnownHeader::accept, "Accept");
+        add(KnownHeader::acceptCharset, "Accept-Charset");
+        add(KnownHeader::acceptEncoding, "Accept-Encoding");
+        add(KnownHeader::acceptLanguage, "Accept-Language");
+        add(KnownHeader::userAgent, "User-Agent");
+        add(KnownHeader::referer, "Referer");
+        add(KnownHeader::origin, "Origin");
+        add(KnownHeader::cookie, "Cookie");
+        add(KnownHeader::authorization, "Authorization");
+        add(KnownHeader::cacheControl, "Cache-Control");
+        add(KnownHeader::pragma, "Pragma");
+        add(KnownHeader::ifModifiedSince, "If-Modified-Since");
+        add(KnownHeader::ifUnmodifiedSince, "If-Unmodified-Since");
+        add(KnownHeader::ifNoneMatch, "If-None-Match");
+        add(KnownHeader::ifMatch, "If-Match");
+        add(KnownHeader::ifRange, "If-Range");
+        add(KnownHeader::range, "Range");
+        add(KnownHeader::contentType, "Content-Type");
+        add(KnownHeader::contentLength, "Content-Length");
+        add(KnownHeader::transferEncoding, "Transfer-Encoding");
+        add(KnownHeader::upgrade, "Upgrade");
+        add(KnownHeader::expect, "Expect");
+        add(KnownHeader::forwarded, "Forwarded");
+        add(KnownHeader::xForwardedFor, "X-Forwarded-For");
+        add(KnownHeader::xForwardedProto, "X-Forwarded-Proto");
+        add(KnownHeader::xRealIp, "X-Real-IP");
+    }
+
+    KnownHeader find(const char *name, std::size_t size) const {
+        if (size >= buckets_.size()) { return KnownHeader::unknown; }
+
+        // only few names share the same length
+        for (const auto &entry : buckets_[size]) {
+            if (std::equal(name, name + size, entry.name
+                           , [](char l, char r) {
+                               return std::tolower
+                                   (static_cast<unsigned char>(l)) == r;
+                           }))
+            {
+                return entry.header;
+            }
+        }
+        return KnownHeader::unknown;
+    }
+
+private:
+    void add(KnownHeader header, const char *name) {
+        const auto size(std::strlen(name));
+        Entry entry{ header, {} };
+        std::transform(name, name + size, entry.name, [](char c) {
+                return std::tolower(static_cast<unsigned char>(c));
+            });
+        buckets_[size].push_back(entry);
+    }
+
+    struct Entry {
+        KnownHeader header;
+        char name[32];
+    };
+
+    std::array<std::vector<Entry>, 32> buckets_;
+};
+
+const KnownHeaders knownHeaders;
+
+} // namespace
+
+KnownHeader knownHeader(const char *name, std::size_t size)
+{
+    return knownHeaders.find(name, size);
+}
+
+void Request::indexHeaders()
+{
+    index_.fill(-1);
+    int i(0);
+    for (const auto &header : headers) {
+        const auto known(knownHeader(header.name));
+        if (known != KnownHeader::unknown) {
+            auto &slot(index_[static_cast<std::size_t>(known)]);
+            // first occurrence wins
+            if (slot < 0) { slot = i; }
+        }
+        ++i;
+    }
+    indexed_ = true;
+    indexedSize_ = headers.size();
+}
+
+const std::string* Request::getHeader(KnownHeader known) const
+{
+    if (known == KnownHeader::unknown) { return nullptr; }
+
+    // use index unless headers have been modified since indexing
+    if (indexed_ && (headers.size() == indexedSize_)) {
+        const auto i(index_[static_cast<std::size_t>(known)]);
+        if (i < 0) { return nullptr; }
+        if (knownHeader(headers[i].name) == known) {
+            return &headers[i].value;
+        }
+    }
+
+    // no (valid) index, linear search
+    for (const auto &header : headers) {
+        if (knownHeader(header.name) == known) {
+            return &header.value;
+        }
+    }
+    return nullptr;
+}
+
 const std::string* Request::getHeader(const std::string &name) const
 {
+    const auto known(knownHeader(name));
+    if (known != KnownHeader::unknown) { return getHeader(known); }
+
     for (const auto &header : headers) {
         if (ba::iequals(header.name, name)) {
             return &header.value;
@@ -1283,6 +2167,186 @@ void Http::Detail::stat(std::ostream &os) const
 {
     connectionCounter_.averageAndMax(os, "http.connections.");
     requestCounter_.averageAndMax(os, "http.requests.");
+    latency_.stat(os);
+    if (accessLog_) {
+        os << "http.accesslog.dropped=" << accessLog_->dropped() << '\n';
+    }
+
+    loopMonitor_.stat(os);
+    for (std::size_t i(0), e(workers_.size()); i < e; ++i) {
+        os << "http.loop.server.worker" << (i + 1) << ".handlers="
+           << handlers_[i] << '\n';
+    }
+    {
+        const auto dispatcher(std::atomic_load(&dispatcher_));
+        if (dispatcher) {
+            int id(0);
+            for (const auto &client : dispatcher->clients()) {
+                os << "http.loop.client" << ++id << ".handlers="
+                   << client->handlers() << '\n';
+            }
+
+            typedef detail::CurlClient::Family Family;
+            for (auto family : { Family::ipv4, Family::ipv6 }) {
+                const auto snapshot(connectLatency(family));
+                if (!snapshot.total) { continue; }
+
+                const std::string name
+                    (std::string("http.client.connect.")
+                     + ((family == Family::ipv6) ? "ipv6." : "ipv4."));
+                os << name << "count=" << snapshot.total << '\n'
+                   << name << "p50=" << snapshot.quantile(0.5) << '\n'
+                   << name << "p90=" << snapshot.quantile(0.9) << '\n'
+                   << name << "p99=" << snapshot.quantile(0.99) << '\n'
+                   << name << "max=" << snapshot.max << '\n';
+            }
+        }
+    }
+}
+
+detail::Histogram::Snapshot
+Http::Detail::connectLatency(detail::CurlClient::Family family) const
+{
+    detail::Histogram::Snapshot snapshot;
+    if (const auto dispatcher = std::atomic_load(&dispatcher_)) {
+        for (const auto &client : dispatcher->clients()) {
+            snapshot.add(client->connectLatency(family));
+        }
+    }
+    return snapshot;
+}
+
+void Http::Detail::loopMonitor(long interval)
+{
+    if (running_) {
+        LOGTHROW(err3, Error)
+            << "Loop monitor must be configured before server is started.";
+    }
+
+    loopMonitor_.interval(interval);
+}
+
+void Http::Detail::metrics(std::ostream &os) const
+{
+    typedef detail::Metrics::Counter Counter;
+    const auto m(metrics_.snapshot());
+
+    const auto metric([&](const char *name, const char *type
+                          , const char *help, std::uint64_t value)
+    {
+        os << "# HELP " << name << ' ' << help << '\n'
+           << "# TYPE " << name << ' ' << type << '\n'
+           << name << ' ' << value << '\n';
+    });
+
+    const auto gauge([](std::uint64_t in, std::uint64_t out)
+    {
+        return (in > out) ? (in - out) : 0;
+    });
+
+    metric("http_connections_accepted_total", "counter"
+           , "Accepted server connections."
+           , m[Counter::connectionsAccepted]);
+    metric("http_connections_open", "gauge"
+           , "Open server connections."
+           , gauge(m[Counter::connectionsAccepted]
+                   , m[Counter::connectionsClosed]));
+    metric("http_requests_total", "counter"
+           , "Requests dispatched to content generators."
+           , m[Counter::requestsDispatched]);
+    metric("http_requests_in_flight", "gauge"
+           , "Requests being generated or sent."
+           , gauge(m[Counter::requestsDispatched]
+                   , m[Counter::requestsFinished]));
+    metric("http_received_bytes_total", "counter"
+           , "Bytes of request lines and headers received."
+           , m[Counter::bytesIn]);
+    metric("http_sent_bytes_total", "counter"
+           , "Bytes written to server connections."
+           , m[Counter::bytesOut]);
+    metric("http_buffered_bytes", "gauge"
+           , "Bytes queued for writing to server connections."
+           , gauge(m[Counter::bytesQueued], m[Counter::bytesDrained]));
+
+    os << "# HELP http_responses_total Responses by status class.\n"
+       << "# TYPE http_responses_total counter\n";
+    {
+        const char *classes[] = { "1xx", "2xx", "3xx", "4xx", "5xx" };
+        for (unsigned i(0); i < 5; ++i) {
+            os << "http_responses_total{class=\"" << classes[i] << "\"} "
+               << m.values[static_cast<unsigned>(Counter::responses1xx) + i]
+               << '\n';
+        }
+    }
+
+    metric("http_client_transfers_total", "counter"
+           , "Started client transfers."
+           , m[Counter::clientTransfersStarted]);
+    metric("http_client_transfers_failed_total", "counter"
+           , "Failed client transfers."
+           , m[Counter::clientTransfersFailed]);
+    metric("http_client_transfers_in_flight", "gauge"
+           , "Running client transfers."
+           , gauge(m[Counter::clientTransfersStarted]
+                   , m[Counter::clientTransfersCompleted]
+                   + m[Counter::clientTransfersFailed]));
+    metric("http_client_received_bytes_total", "counter"
+           , "Bytes of content received by client transfers."
+           , m[Counter::clientBytesIn]);
+    metric("http_client_sockets_opened_total", "counter"
+           , "Sockets opened by client transfers."
+           , m[Counter::clientSocketsOpened]);
+    metric("http_client_transfers_queued_total", "counter"
+           , "Client transfers that waited for per-host slot."
+           , m[Counter::clientTransfersQueued]);
+    metric("http_client_transfers_cancelled_total", "counter"
+           , "Client requests cancelled before completion."
+           , m[Counter::clientTransfersCancelled]);
+    metric("http_client_dispatch_spillovers_total", "counter"
+           , "Requests sent to other than host's preferred client."
+           , m[Counter::clientDispatchSpillovers]);
+
+    metric("http_dns_cache_hits_total", "counter"
+           , "DNS cache hits.", dnsCache_.hits());
+    metric("http_dns_cache_misses_total", "counter"
+           , "DNS cache misses.", dnsCache_.misses());
+    metric("http_dns_cache_refreshes_total", "counter"
+           , "Background refreshes of DNS cache entries."
+           , dnsCache_.refreshes());
+    metric("http_dns_cache_entries", "gauge"
+           , "DNS cache entries.", dnsCache_.size());
+
+    {
+        os << "# HELP http_client_connect_duration_microseconds TCP connect "
+            "latency of new client connections by address family.\n"
+           << "# TYPE http_client_connect_duration_microseconds summary\n";
+
+        typedef detail::CurlClient::Family Family;
+        for (auto family : { Family::ipv4, Family::ipv6 }) {
+            const auto snapshot(connectLatency(family));
+            const std::string labels
+                ((family == Family::ipv6)
+                 ? "family=\"ipv6\"" : "family=\"ipv4\"");
+
+            for (auto q : { 0.5, 0.9, 0.99 }) {
+                os << "http_client_connect_duration_microseconds{" << labels
+                   << ",quantile=\"" << q << "\"} "
+                   << snapshot.quantile(q) << '\n';
+            }
+            os << "http_client_connect_duration_microseconds_sum{"
+               << labels << "} " << snapshot.sum << '\n'
+               << "http_client_connect_duration_microseconds_count{"
+               << labels << "} " << snapshot.total << '\n';
+        }
+    }
+
+    if (accessLog_) {
+        metric("http_accesslog_dropped_total", "counter"
+               , "Access log records dropped due to overload."
+               , accessLog_->dropped());
+    }
+
+    latency_.prometheus(os);
 }
 
 void Http::stat(std::ostream &os) const
@@ -1290,4 +2354,19 @@ void Http::stat(std::ostream &os) const
     return detail().stat(os);
 }
 
+void Http::metrics(std::ostream &os) const
+{
+    return detail().metrics(os);
+}
+
+void Http::tracing(unsigned int sampleRate, std::size_t bufferSize)
+{
+    detail().tracer().configure(sampleRate, bufferSize);
+}
+
+void Http::dumpTrace(std::ostream &os) const
+{
+    detail().tracer().dump(os);
+}
+
 } // namespace http
@@ -28,11 +28,13 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "utility/tcpendpoint.hpp"
 
 #include "contentgenerator.hpp"
 #include "contentfetcher.hpp"
+#include "memorystream.hpp"
 
 namespace http {
 
@@ -79,6 +81,25 @@ public:
     utility::TcpEndpoint listen(const utility::TcpEndpoint &listen
                                 , ContentGenerator &contentGenerator);
 
+    /** Opens in-memory connection to the server machinery. Requests written
+     *  to returned stream are handled by given content generator exactly as
+     *  if they were received over TCP (parsing, dispatch, sinks), only
+     *  without kernel sockets. Meant for benchmarking and testing.
+     *
+     *  Connection is closed by server when stopped.
+     *
+     * \param contentGenerator request handler
+     * \return client end of the connection
+     */
+    MemoryStream::pointer
+    connect(const ContentGenerator::pointer &contentGenerator);
+
+    /** Opens in-memory connection to the server machinery.
+     *
+     *  NB: contentGenerator must survive this object
+     */
+    MemoryStream::pointer connect(ContentGenerator &contentGenerator);
+
     /** Start server-side processing machinery.
      */
     void startServer(unsigned int threadCount);
@@ -96,12 +117,87 @@ public:
      */
     void serverHeader(const std::string &value);
 
+    /** Set path of batch endpoint. Empty path (default) disables batching.
+     *
+     *  Batch request query is a list of &-separated url-encoded resource
+     *  URIs (e.g. /batch?%2Fa%2Fb.png&%2Fa%2Fc.png). Each resource is
+     *  generated by the listener's content generator and sent back as a
+     *  part of a multipart/mixed response as soon as it is ready. Each part
+     *  is an application/http message with its own status and headers.
+     */
+    void batchPath(const std::string &path);
+
+    /** Sets event loop monitor probing interval (in milliseconds, default
+     *  100 ms). Monitor periodically posts a probe to server and client
+     *  io_services and records how long it waits to be run; lag percentiles
+     *  are reported by stat(). Zero disables probing. Must be called before
+     *  server and client are started.
+     */
+    void loopMonitor(long interval);
+
+    /** Enables/disables Server-Timing header in responses (disabled by
+     *  default). Header carries time spent in connection queue (queue), in
+     *  content generator (gen) and serializing response (ser).
+     */
+    void serverTiming(bool enable);
+
+    /** Logs one-line stage breakdown of requests that took longer than given
+     *  threshold (in milliseconds). Non-positive value (default) disables
+     *  logging.
+     */
+    void slowRequestLog(long threshold);
+
+    /** Enables asynchronous access log. Must be called before server is
+     *  started.
+     *
+     *  Finished requests are queued in a bounded ring buffer and written by
+     *  a background thread in batches. Records are dropped (and counted) when
+     *  the ring is full; IO threads never block on logging.
+     *
+     *  Each line contains: time, connection id, request line, status, bytes
+     *  sent, total time and time spent in connection queue (microseconds).
+     *
+     * \param path output file (appended to), empty path logs via dbglog
+     * \param capacity maximum number of pending records
+     */
+    void accessLog(const std::string &path, std::size_t capacity = 1 << 14);
+
+    /** Sets route prefixes for latency statistics. Request is accounted to
+     *  the route with longest prefix of its path (in addition to overall
+     *  statistics). Must be called before server is started.
+     *
+     *  Latency percentiles are reported by stat().
+     */
+    void latencyRoutes(const std::vector<std::string> &prefixes);
+
     /** Returns content fetcher interface.
      */
     ContentFetcher& fetcher();
 
     void stat(std::ostream &os) const;
 
+    /** Prints statistics in Prometheus text exposition format. Values are
+     *  gathered from per-thread counters, workers are never stopped.
+     */
+    void metrics(std::ostream &os) const;
+
+    /** Configures sampled request tracing. Can be changed any time.
+     *
+     *  Every sampleRate-th request (per IO thread) and client transfer is
+     *  traced: timestamped spans of its processing stages (parsing, queueing,
+     *  generation, data source reads, socket writes, ...) are kept in
+     *  per-thread ring buffers of bufferSize spans.
+     *
+     * \param sampleRate trace every n-th request, 0 disables tracing
+     * \param bufferSize maximum number of spans kept per thread
+     */
+    void tracing(unsigned int sampleRate, std::size_t bufferSize = 1 << 14);
+
+    /** Dumps recorded spans in Chrome trace-event JSON format (viewable in
+     *  chrome://tracing or Perfetto).
+     */
+    void dumpTrace(std::ostream &os) const;
+
     class Detail;
     friend class Detail;
 
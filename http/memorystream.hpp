@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef http_memorystream_hpp_included_
+#define http_memorystream_hpp_included_
+
+#include <memory>
+#include <cstddef>
+
+namespace http {
+
+/** Client end of an in-memory duplex pipe connected to the server machinery
+ *  (see Http::connect). Data written to the stream are received by the
+ *  server as if they came from a TCP connection; response data are read
+ *  back. No kernel sockets are involved.
+ *
+ *  Meant for benchmarking and testing. All operations are thread safe.
+ */
+class MemoryStream {
+public:
+    typedef std::shared_ptr<MemoryStream> pointer;
+
+    virtual ~MemoryStream() {}
+
+    /** Sends data to the server. Never blocks. Data are dropped if the
+     *  server side has been closed.
+     */
+    void write(const void *data, std::size_t size);
+
+    /** Reads data sent by the server. Blocks until at least one byte is
+     *  available.
+     *
+     * \return number of bytes read, 0 when server closed the connection
+     */
+    std::size_t read(void *data, std::size_t size);
+
+    /** Closes client side of the stream. Server sees end of file.
+     */
+    void close();
+
+private:
+    virtual void write_impl(const void *data, std::size_t size) = 0;
+    virtual std::size_t read_impl(void *data, std::size_t size) = 0;
+    virtual void close_impl() = 0;
+};
+
+// inlines
+
+inline void MemoryStream::write(const void *data, std::size_t size)
+{
+    write_impl(data, size);
+}
+
+inline std::size_t MemoryStream::read(void *data, std::size_t size)
+{
+    return read_impl(data, size);
+}
+
+inline void MemoryStream::close()
+{
+    close_impl();
+}
+
+} // namespace http
+
+#endif // http_memorystream_hpp_included_
@@ -29,6 +29,7 @@
 #include "ondemandclient.hpp"
 #include "contentfetcher.hpp"
 #include "detail/curl.hpp"
+#include "detail/dispatcher.hpp"
 
 namespace http {
 
@@ -40,36 +41,41 @@ struct OnDemandClient::Detail : public ContentFetcher
 
     std::mutex mutex_;
     std::size_t threadCount;
-    detail::CurlClient::list clients;
-    detail::CurlClient::list::iterator currentClient;
+    detail::Dispatcher::pointer dispatcher;
     ResourceFetcher fetcher;
 
-    virtual void fetch_impl(const std::string &location
-                            , const ClientSink::pointer &sink
-                            , const ContentFetcher::RequestOptions &options);
+    virtual Cancel fetch_impl(const std::string &location
+                              , const ClientSink::pointer &sink
+                              , const ContentFetcher::RequestOptions &options);
 };
 
-void OnDemandClient::Detail
+ContentFetcher::Cancel OnDemandClient::Detail
 ::fetch_impl(const std::string &location
              , const ClientSink::pointer &sink
              , const ContentFetcher::RequestOptions &options)
 {
     try {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (clients.empty()) {
-            for (int i(0); i < int(threadCount); ++i) {
-                clients.push_back(std::make_shared<detail::CurlClient>(i));
+        auto d(std::atomic_load(&dispatcher));
+        if (!d) {
+            // first use: create clients
+            std::lock_guard<std::mutex> lock(mutex_);
+            d = std::atomic_load(&dispatcher);
+            if (!d) {
+                detail::CurlClient::list clients;
+                for (int i(0); i < int(threadCount); ++i) {
+                    clients.push_back
+                        (std::make_shared<detail::CurlClient>(i));
+                }
+                d = std::make_shared<detail::Dispatcher>(clients);
+                std::atomic_store(&dispatcher, d);
             }
-            currentClient = clients.begin();
         }
 
-        (*currentClient)->fetch(location, sink, options);
-        if (++currentClient == clients.end()) {
-            currentClient = clients.begin();
-        }
+        return d->client(location).fetch(location, sink, options);
     } catch (...) {
         sink->error();
     }
+    return {};
 }
 
 OnDemandClient::OnDemandClient(std::size_t threads)
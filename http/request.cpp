@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include "request.hpp"
+#include "detail/scan.hpp"
+
+namespace http {
+
+namespace {
+
+inline int hexValue(char c)
+{
+    if ((c >= '0') && (c <= '9')) { return c - '0'; }
+    if ((c >= 'a') && (c <= 'f')) { return c - 'a' + 10; }
+    if ((c >= 'A') && (c <= 'F')) { return c - 'A' + 10; }
+    return -1;
+}
+
+void decode(const boost::string_ref &raw, std::string &out)
+{
+    out.assign(raw.data(), raw.size());
+    out.resize(detail::scan::urlDecode(&out[0], out.size(), true));
+}
+
+} // namespace
+
+bool QueryParam::is(const boost::string_ref &name) const
+{
+    // decode on the fly and compare
+    auto n(name.begin());
+    const auto ne(name.end());
+    for (auto k(key.begin()), ke(key.end()); k != ke; ++k, ++n) {
+        if (n == ne) { return false; }
+
+        char c(*k);
+        if (c == '+') {
+            c = ' ';
+        } else if ((c == '%') && ((ke - k) >= 3)) {
+            const auto hi(hexValue(k[1]));
+            const auto lo(hexValue(k[2]));
+            if ((hi >= 0) && (lo >= 0)) {
+                c = char((hi << 4) | lo);
+                k += 2;
+            }
+        }
+
+        if (c != *n) { return false; }
+    }
+    return n == ne;
+}
+
+std::string QueryParam::decodedKey() const
+{
+    std::string out;
+    decode(key, out);
+    return out;
+}
+
+std::string QueryParam::decodedValue() const
+{
+    std::string out;
+    decode(value, out);
+    return out;
+}
+
+void QueryParam::decodeValue(std::string &out) const
+{
+    decode(value, out);
+}
+
+boost::optional<QueryParam>
+QueryParams::find(const boost::string_ref &key) const
+{
+    for (const auto &param : *this) {
+        if (param.is(key)) { return param; }
+    }
+    return boost::none;
+}
+
+boost::optional<std::string>
+QueryParams::get(const boost::string_ref &key) const
+{
+    if (const auto param = find(key)) { return param->decodedValue(); }
+    return boost::none;
+}
+
+QueryParams Request::params() const
+{
+    if (!paramsParsed_) {
+        params_.clear();
+
+        // key[=value] items separated by '&'
+        const char *data(query.data());
+        const char *b(data);
+        const char *e(b + query.size());
+        while (b != e) {
+            const auto *amp(detail::scan::find(b, e, '&'));
+            if (amp != b) {
+                const auto *eq(std::find(b, amp, '='));
+                QueryParams::Span span;
+                span.key = std::uint32_t(b - data);
+                span.keySize = std::uint32_t(eq - b);
+                span.value = std::uint32_t((eq == amp) ? amp - data
+                                           : eq + 1 - data);
+                span.valueSize = std::uint32_t(amp - data - span.value);
+                params_.push_back(span);
+            }
+            b = (amp == e) ? e : amp + 1;
+        }
+
+        paramsParsed_ = true;
+    }
+
+    return QueryParams(query, params_);
+}
+
+} // namespace http
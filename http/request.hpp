@@ -26,8 +26,14 @@
 #ifndef http_request_hpp_included_
 #define http_request_hpp_included_
 
+#include <array>
 #include <string>
 #include <vector>
+#include <cstdint>
+#include <iterator>
+
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
 
 namespace http {
 
@@ -42,6 +48,143 @@ struct Header {
         : name(name), value(value) {}
 };
 
+/** Well-known header names. Headers with these names are indexed by request
+ *  parser and can be looked up in constant time.
+ */
+enum class KnownHeader {
+    host, connection, accept, acceptCharset, acceptEncoding, acceptLanguage
+    , userAgent, referer, origin, cookie, authorization, cacheControl, pragma
+    , ifModifiedSince, ifUnmodifiedSince, ifNoneMatch, ifMatch, ifRange
+    , range, contentType, contentLength, transferEncoding, upgrade, expect
+    , forwarded, xForwardedFor, xForwardedProto, xRealIp
+
+    // not a well-known header; must be last
+    , unknown
+};
+
+/** Classifies header name (case insensitive).
+ *
+ * \param name header name
+ * \param size length of name
+ * \return well-known header or KnownHeader::unknown
+ */
+KnownHeader knownHeader(const char *name, std::size_t size);
+
+/** Classifies header name (case insensitive).
+ */
+KnownHeader knownHeader(const std::string &name);
+
+/** Single query string parameter. Key and value are raw (url-encoded) views
+ *  into the request's query string.
+ */
+struct QueryParam {
+    boost::string_ref key;
+    boost::string_ref value;
+
+    QueryParam(const boost::string_ref &key = boost::string_ref()
+               , const boost::string_ref &value = boost::string_ref())
+        : key(key), value(value)
+    {}
+
+    /** Compares url-decoded key with given string. Does not allocate.
+     */
+    bool is(const boost::string_ref &name) const;
+
+    /** Returns url-decoded key.
+     */
+    std::string decodedKey() const;
+
+    /** Returns url-decoded value.
+     */
+    std::string decodedValue() const;
+
+    /** Url-decodes value into given string, existing storage is reused.
+     */
+    void decodeValue(std::string &out) const;
+};
+
+/** Lightweight view of parsed query string parameters. Valid as long as the
+ *  request it has been obtained from is alive and its query is not modified.
+ */
+class QueryParams {
+public:
+    /** Parameter position in the query string.
+     */
+    struct Span {
+        std::uint32_t key;
+        std::uint32_t keySize;
+        std::uint32_t value;
+        std::uint32_t valueSize;
+
+        typedef std::vector<Span> list;
+    };
+
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef QueryParam value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef void pointer;
+        typedef QueryParam reference;
+
+        const_iterator(const std::string &query
+                       , Span::list::const_iterator it)
+            : query_(&query), it_(it)
+        {}
+
+        QueryParam operator*() const {
+            return QueryParam(boost::string_ref(query_->data() + it_->key
+                                                , it_->keySize)
+                              , boost::string_ref(query_->data() + it_->value
+                                                  , it_->valueSize));
+        }
+
+        const_iterator& operator++() { ++it_; return *this; }
+        const_iterator operator++(int) { auto tmp(*this); ++it_; return tmp; }
+
+        bool operator==(const const_iterator &o) const { return it_ == o.it_; }
+        bool operator!=(const const_iterator &o) const { return it_ != o.it_; }
+
+    private:
+        const std::string *query_;
+        Span::list::const_iterator it_;
+    };
+
+    typedef const_iterator iterator;
+
+    QueryParams(const std::string &query, const Span::list &spans)
+        : query_(&query), spans_(&spans)
+    {}
+
+    const_iterator begin() const {
+        return const_iterator(*query_, spans_->begin());
+    }
+
+    const_iterator end() const {
+        return const_iterator(*query_, spans_->end());
+    }
+
+    std::size_t size() const { return spans_->size(); }
+    bool empty() const { return spans_->empty(); }
+
+    /** Finds first parameter with given (url-decoded) key. Does not
+     *  allocate.
+     */
+    boost::optional<QueryParam> find(const boost::string_ref &key) const;
+
+    /** Checks for presence of parameter with given key.
+     */
+    bool has(const boost::string_ref &key) const { return bool(find(key)); }
+
+    /** Returns url-decoded value of first parameter with given key.
+     */
+    boost::optional<std::string> get(const boost::string_ref &key) const;
+
+private:
+    const std::string *query_;
+    const Span::list *spans_;
+};
+
 struct Request {
     /** Uri as received from client
      */
@@ -57,16 +200,76 @@ struct Request {
 
     Header::list headers;
 
+    Request() : indexed_(false), indexedSize_(), paramsParsed_(false) {}
+
     bool hasHeader(const std::string &name) const;
 
+    bool hasHeader(KnownHeader header) const;
+
+    /** Finds header by name. Well-known headers are found in constant time
+     *  if headers are indexed (see indexHeaders()).
+     */
     const std::string* getHeader(const std::string &name) const;
+
+    /** Finds well-known header. Constant time if headers are indexed, linear
+     *  search otherwise.
+     */
+    const std::string* getHeader(KnownHeader header) const;
+
+    /** (Re)builds index of well-known headers. Done by request parser.
+     *
+     *  Index is not used (lookups fall back to linear search) once number
+     *  of headers changes or indexed slot holds different header. Headers
+     *  renamed or replaced without changing their count require
+     *  re-indexing.
+     */
+    void indexHeaders();
+
+    /** Query string parameters. Query is parsed on first use (i.e. at most
+     *  once per request), values are decoded on demand.
+     *
+     *  NB: first call is not thread safe.
+     */
+    QueryParams params() const;
+
+    /** Forgets parsed query string parameters. Must be called after query is
+     *  modified.
+     */
+    void resetParams() { paramsParsed_ = false; }
+
+private:
+    typedef std::array<int, static_cast<std::size_t>(KnownHeader::unknown)>
+        HeaderIndex;
+
+    /** Position of first occurrence of each well-known header in headers
+     *  list, -1 if not present. Valid only if indexed_ is set and headers
+     *  list still has indexedSize_ entries.
+     */
+    HeaderIndex index_;
+    bool indexed_;
+    std::size_t indexedSize_;
+
+    /** Parsed query parameters, stored as offsets so request can be copied.
+     */
+    mutable QueryParams::Span::list params_;
+    mutable bool paramsParsed_;
 };
 
+inline KnownHeader knownHeader(const std::string &name)
+{
+    return knownHeader(name.data(), name.size());
+}
+
 inline bool Request::hasHeader(const std::string &name) const
 {
     return getHeader(name);
 }
 
+inline bool Request::hasHeader(KnownHeader header) const
+{
+    return getHeader(header);
+}
+
 } // namespace http
 
 #endif // http_request_hpp_included_
@@ -30,6 +30,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <functional>
 #include <exception>
 #include <iosfwd>
 
@@ -131,6 +132,60 @@ public:
         bool hasContentLength_;
     };
 
+    /** Piece of content sent by gathered content(...) call.
+     *
+     *  Borrowed fragment (raw pointer and size) is not copied and therefore
+     *  must survive until response is sent (same rules as content(data,
+     *  size, stat, false)).
+     *
+     *  Owned fragment holds its data itself via shared pointer.
+     */
+    struct Fragment {
+        const void *data;
+        std::size_t size;
+        std::shared_ptr<const void> owner;
+
+        typedef std::vector<Fragment> list;
+
+        /** Borrowed fragment.
+         */
+        Fragment(const void *data = nullptr, std::size_t size = 0)
+            : data(data), size(size)
+        {}
+
+        /** Owned fragment.
+         */
+        Fragment(const std::shared_ptr<const std::string> &data)
+            : data(data->data()), size(data->size()), owner(data)
+        {}
+
+        /** Owned fragment.
+         */
+        template <typename T>
+        Fragment(const std::shared_ptr<const std::vector<T>> &data)
+            : data(data->data()), size(data->size() * sizeof(T))
+            , owner(data)
+        {}
+
+        /** Creates owned fragment from given data.
+         */
+        static Fragment own(std::string &&data) {
+            return Fragment(std::make_shared<const std::string>
+                            (std::move(data)));
+        }
+
+        /** Creates owned fragment from a copy of given data.
+         */
+        static Fragment copy(const void *data, std::size_t size) {
+            return Fragment(std::make_shared<const std::string>
+                            (static_cast<const char*>(data), size));
+        }
+
+        /** Total size of all fragments in given list.
+         */
+        static std::size_t totalSize(const list &fragments);
+    };
+
     /** Sends content to client.
      * \param data data top send
      * \param stat file info (size is ignored)
@@ -139,6 +194,17 @@ public:
     void content(const std::string &data, const FileInfo &stat
                  , const Header::list *headers = nullptr);
 
+    /** Sends content to client. Data are moved into owned fragment passed
+     *  to gather_impl(); only sinks that override gather_impl() can keep
+     *  them without copying (default implementation passes them to
+     *  content_impl() with needCopy set).
+     * \param data data top send
+     * \param stat file info (size is ignored)
+     * \param headers additional (optional) headers
+     */
+    void content(std::string &&data, const FileInfo &stat
+                 , const Header::list *headers = nullptr);
+
     /** Sends content to client.
      * \param data data top send
      * \param stat file info (size is ignored)
@@ -159,6 +225,16 @@ public:
                  , const FileInfo &stat, bool needCopy
                  , const Header::list *headers = nullptr);
 
+    /** Sends content gathered from multiple fragments to client. Fragments
+     *  are sent as is, without concatenation, if possible.
+     *
+     * \param fragments list of data fragments
+     * \param stat file info (size is ignored)
+     * \param headers additional (optional) headers
+     */
+    void content(const Fragment::list &fragments, const FileInfo &stat
+                 , const Header::list *headers = nullptr);
+
     /** Sends current exception to the client.
      */
     void error();
@@ -199,6 +275,14 @@ protected: // needed do to -Wvirtual-override
     virtual void content_impl(const void *data, std::size_t size
                               , const FileInfo &stat, bool needCopy
                               , const Header::list *headers) = 0;
+    /** Default implementation sends single fragment as is and multiple
+     *  fragments concatenated via content_impl(data, size, ...) with
+     *  needCopy set. Override to take ownership of owned fragments
+     *  (Fragment::owner) without copying.
+     */
+    virtual void gather_impl(const Fragment::list &fragments
+                             , const FileInfo &stat
+                             , const Header::list *headers);
     virtual void error_impl(const std::exception_ptr &exc) = 0;
     virtual void error_impl(const std::error_code &ec
                             , const std::string &message) = 0;
@@ -264,6 +348,14 @@ private:
     virtual void setAborter_impl(const AbortedCallback &ac) = 0;
 };
 
+/** Sink receiving response from the fetcher.
+ *
+ *  Whole body is delivered via content(std::string&&), i.e. through
+ *  gather_impl() as single owned fragment. Sink that wants to keep the
+ *  body without copying must override gather_impl() and hold
+ *  Fragment::owner; default implementation copies (content_impl() with
+ *  needCopy set).
+ */
 class ClientSink : public SinkBase {
 public:
     typedef std::shared_ptr<ClientSink> pointer;
@@ -279,6 +371,63 @@ private:
     virtual void notModified_impl();
 };
 
+/** Client sink receiving response body incrementally, as it arrives from the
+ *  network. Body is never accumulated in memory.
+ *
+ *  For successful (2xx) response start() is called once all headers are
+ *  received, followed by chunk() for each piece of body and finish() at
+ *  the end. Failure (even in the middle of the body), redirect and
+ *  not-modified are reported via regular ClientSink interface.
+ *
+ *  Backpressure: chunk() returns false to pause the transfer; chunk is then
+ *  considered not consumed and is delivered again (possibly extended) once
+ *  the transfer is resumed by calling the resume function passed to
+ *  start(). Resume function can be called from any thread at any time; it
+ *  does nothing once the transfer is gone.
+ *
+ *  All callbacks are called from a client thread.
+ */
+class StreamingClientSink : public ClientSink {
+public:
+    typedef std::shared_ptr<StreamingClientSink> pointer;
+    typedef std::function<void()> Resume;
+
+    StreamingClientSink() {}
+
+    /** Response headers received.
+     *
+     * \param stat response info
+     * \param contentLength body size, -1 if unknown
+     * \param resume function to resume paused transfer
+     */
+    void start(const FileInfo &stat, long contentLength
+               , const Resume &resume);
+
+    /** Piece of body received. Data are valid only during the call.
+     *
+     * \return true when chunk has been consumed, false to pause transfer
+     */
+    bool chunk(const void *data, std::size_t size);
+
+    /** Whole body received.
+     */
+    void finish();
+
+protected:
+    /** Buffered content is streamed as a single chunk. Pause request is
+     *  ignored.
+     */
+    virtual void content_impl(const void *data, std::size_t size
+                              , const FileInfo &stat, bool needCopy
+                              , const Header::list *headers);
+
+private:
+    virtual void start_impl(const FileInfo &stat, long contentLength
+                            , const Resume &resume) = 0;
+    virtual bool chunk_impl(const void *data, std::size_t size) = 0;
+    virtual void finish_impl() = 0;
+};
+
 // inlines
 
 inline void SinkBase::content(const std::string &data, const FileInfo &stat
@@ -287,6 +436,12 @@ inline void SinkBase::content(const std::string &data, const FileInfo &stat
     content_impl(data.data(), data.size(), stat, true, headers);
 }
 
+inline void SinkBase::content(std::string &&data, const FileInfo &stat
+                              , const Header::list *headers)
+{
+    gather_impl({ Fragment::own(std::move(data)) }, stat, headers);
+}
+
 inline void SinkBase::content(const void *data, std::size_t size
                               , const FileInfo &stat, bool needCopy
                               , const Header::list *headers)
@@ -294,6 +449,20 @@ inline void SinkBase::content(const void *data, std::size_t size
     content_impl(data, size, stat, needCopy, headers);
 }
 
+inline void SinkBase::content(const Fragment::list &fragments
+                              , const FileInfo &stat
+                              , const Header::list *headers)
+{
+    gather_impl(fragments, stat, headers);
+}
+
+inline std::size_t SinkBase::Fragment::totalSize(const list &fragments)
+{
+    std::size_t total(0);
+    for (const auto &fragment : fragments) { total += fragment.size; }
+    return total;
+}
+
 template <typename T>
 inline void SinkBase::content(const std::vector<T> &data, const FileInfo &stat
                               , const Header::list *headers)
@@ -362,6 +531,30 @@ inline void ClientSink::notModified_impl() {
     error(make_error_code(utility::HttpCode::NotModified));
 }
 
+inline void StreamingClientSink::start(const FileInfo &stat
+                                       , long contentLength
+                                       , const Resume &resume)
+{
+    start_impl(stat, contentLength, resume);
+}
+
+inline bool StreamingClientSink::chunk(const void *data, std::size_t size)
+{
+    return chunk_impl(data, size);
+}
+
+inline void StreamingClientSink::finish() { finish_impl(); }
+
+inline void StreamingClientSink::content_impl(const void *data
+                                              , std::size_t size
+                                              , const FileInfo &stat, bool
+                                              , const Header::list*)
+{
+    start(stat, long(size), [](){});
+    if (size) { chunk(data, size); }
+    finish();
+}
+
 } // namespace http
 
 #endif // http_sink_hpp_included_
@@ -0,0 +1,637 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** Local load-generation benchmark.
+ *
+ *  Starts HTTP server on loopback and drives it by a configurable number of
+ *  raw (keep-alive, optionally pipelined) client connections. Connections
+ *  use either loopback TCP or in-memory streams (Http::connect). Each
+ *  scenario (payload size x response mode) is reported as a single JSON
+ *  line.
+ */
+
+#include <sys/resource.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <map>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <boost/optional.hpp>
+#include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/thread.hpp>
+
+#include "utility/tcpendpoint-io.hpp"
+#include "utility/buildsys.hpp"
+#include "service/cmdline.hpp"
+
+#include "http/http.hpp"
+#include "http/error.hpp"
+#include "http/memorystream.hpp"
+
+namespace po = boost::program_options;
+namespace asio = boost::asio;
+namespace bs = boost::system;
+namespace ba = boost::algorithm;
+typedef asio::ip::tcp tcp;
+typedef std::chrono::steady_clock Clock;
+
+/** Allocation counting: all global allocations in this process.
+ */
+namespace {
+std::atomic<std::uint64_t> allocations(0);
+
+void* allocate(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto *p = std::malloc(size ? size : 1)) { return p; }
+    throw std::bad_alloc();
+}
+} // namespace
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+/** Returns number of bytes consumed by one complete response at the start of
+ *  given data or 0 if response is incomplete. Handles Content-Length and
+ *  chunked bodies (without trailers).
+ */
+std::size_t completeResponse(const char *b, const char *e, int &status)
+{
+    const char crlf2[] = "\r\n\r\n";
+    const auto *hend(std::search(b, e, crlf2, crlf2 + 4));
+    if (hend == e) { return 0; }
+
+    status = ((e - b) > 12) ? std::atoi(b + 9) : 0;
+
+    long contentLength(-1);
+    bool chunked(false);
+    for (const auto *line(std::find(b, hend, '\n') + 1); line < hend; ) {
+        const auto *eol(std::find(line, hend, '\r'));
+        const std::string header(line, eol);
+        if (ba::istarts_with(header, "content-length:")) {
+            contentLength = std::atol(header.c_str() + 15);
+        } else if (ba::istarts_with(header, "transfer-encoding:")
+                   && ba::icontains(header, "chunked"))
+        {
+            chunked = true;
+        }
+        line = eol + 2;
+    }
+
+    const auto *body(hend + 4);
+    if (chunked) {
+        for (const auto *p(body); ; ) {
+            const auto *eol(std::find(p, e, '\r'));
+            if ((e - eol) < 2) { return 0; }
+            const auto size(std::strtoul(std::string(p, eol).c_str()
+                                         , nullptr, 16));
+            p = eol + 2;
+            if ((e - p) < long(size + 2)) { return 0; }
+            p += size + 2;
+            if (!size) { return p - b; }
+        }
+    }
+
+    if (contentLength < 0) { contentLength = 0; }
+    if ((e - body) < contentLength) { return 0; }
+    return (body - b) + contentLength;
+}
+
+/** Per-connection results.
+ */
+struct Stats {
+    std::uint64_t requests;
+    std::uint64_t errors;
+    std::uint64_t bytes;
+
+    /** Latencies in microseconds.
+     */
+    std::vector<std::uint64_t> latencies;
+
+    Stats() : requests(), errors(), bytes() {}
+
+    void merge(const Stats &other) {
+        requests += other.requests;
+        errors += other.errors;
+        bytes += other.bytes;
+        latencies.insert(latencies.end(), other.latencies.begin()
+                         , other.latencies.end());
+    }
+};
+
+/** Keep-alive client connection. Sends batches of pipelined requests and
+ *  waits for all responses before sending next batch.
+ */
+class Client {
+public:
+    virtual ~Client() {}
+
+    /** Runs requests until deadline. Calls done when finished.
+     */
+    virtual void run(const std::string &path, std::size_t pipeline
+                     , Clock::time_point deadline
+                     , const std::function<void()> &done) = 0;
+
+    const Stats& stats() const { return stats_; }
+
+protected:
+    void reset(const std::string &path, std::size_t pipeline) {
+        batch_.clear();
+        for (std::size_t i(0); i < pipeline; ++i) {
+            batch_ += "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        }
+        pipeline_ = pipeline;
+        stats_ = Stats();
+        stats_.latencies.reserve(1 << 16);
+        in_.clear();
+    }
+
+    /** Consumes complete responses from input buffer, updates left_.
+     */
+    void parse() {
+        const auto now(Clock::now());
+        std::size_t off(0);
+        int status(0);
+        while (left_) {
+            const auto used(completeResponse(in_.data() + off
+                                             , in_.data() + in_.size()
+                                             , status));
+            if (!used) { break; }
+            off += used;
+            --left_;
+            ++stats_.requests;
+            if (status != 200) { ++stats_.errors; }
+            stats_.latencies.push_back
+                (std::chrono::duration_cast<std::chrono::microseconds>
+                 (now - sent_).count());
+        }
+        in_.erase(0, off);
+    }
+
+    std::string in_;
+    std::string batch_;
+    std::size_t pipeline_;
+    std::size_t left_;
+    Clock::time_point sent_;
+    Stats stats_;
+};
+
+/** Client connected over loopback TCP, driven by client io_service.
+ */
+class TcpClient : public Client {
+public:
+    TcpClient(asio::io_service &ios) : socket_(ios), buffer_(1 << 16) {}
+
+    void connect(const tcp::endpoint &endpoint) {
+        socket_.connect(endpoint);
+        socket_.set_option(tcp::no_delay(true));
+    }
+
+    virtual void run(const std::string &path, std::size_t pipeline
+                     , Clock::time_point deadline
+                     , const std::function<void()> &done)
+    {
+        reset(path, pipeline);
+        deadline_ = deadline;
+        done_ = done;
+        send();
+    }
+
+private:
+    void send() {
+        if (Clock::now() >= deadline_) { done_(); return; }
+
+        sent_ = Clock::now();
+        left_ = pipeline_;
+        asio::async_write(socket_, asio::buffer(batch_)
+                          , [this](const bs::error_code &ec, std::size_t)
+        {
+            if (ec) { fail(); return; }
+            read();
+        });
+    }
+
+    void read() {
+        socket_.async_read_some(asio::buffer(buffer_)
+                                , [this](const bs::error_code &ec
+                                         , std::size_t bytes)
+        {
+            if (ec) { fail(); return; }
+            stats_.bytes += bytes;
+            in_.append(buffer_.data(), bytes);
+            parse();
+            if (left_) { read(); } else { send(); }
+        });
+    }
+
+    void fail() {
+        stats_.errors += left_;
+        done_();
+    }
+
+    tcp::socket socket_;
+    std::vector<char> buffer_;
+    Clock::time_point deadline_;
+    std::function<void()> done_;
+};
+
+/** Client connected via in-memory stream (no kernel sockets). Blocking,
+ *  runs in its own thread.
+ */
+class MemoryClient : public Client {
+public:
+    MemoryClient(const http::MemoryStream::pointer &stream)
+        : stream_(stream), buffer_(1 << 16)
+    {}
+
+    ~MemoryClient() {
+        stream_->close();
+        if (thread_.joinable()) { thread_.join(); }
+    }
+
+    virtual void run(const std::string &path, std::size_t pipeline
+                     , Clock::time_point deadline
+                     , const std::function<void()> &done)
+    {
+        if (thread_.joinable()) { thread_.join(); }
+        reset(path, pipeline);
+        thread_ = std::thread([this, deadline, done]()
+        {
+            loop(deadline);
+            done();
+        });
+    }
+
+private:
+    void loop(Clock::time_point deadline) {
+        while (Clock::now() < deadline) {
+            sent_ = Clock::now();
+            left_ = pipeline_;
+            stream_->write(batch_.data(), batch_.size());
+
+            while (left_) {
+                const auto bytes(stream_->read(buffer_.data()
+                                               , buffer_.size()));
+                if (!bytes) {
+                    stats_.errors += left_;
+                    return;
+                }
+                stats_.bytes += bytes;
+                in_.append(buffer_.data(), bytes);
+                parse();
+            }
+        }
+    }
+
+    http::MemoryStream::pointer stream_;
+    std::vector<char> buffer_;
+    std::thread thread_;
+};
+
+class DataSource : public http::ServerSink::DataSource {
+public:
+    DataSource(const std::string &data) : data_(data) {}
+
+    virtual http::SinkBase::FileInfo stat() const {
+        return { "application/octet-stream", -1 };
+    }
+
+    virtual std::size_t read(char *buf, std::size_t size
+                             , std::size_t off)
+    {
+        if (off >= data_.size()) { return 0; }
+        size = std::min(size, data_.size() - off);
+        std::memcpy(buf, data_.data() + off, size);
+        return size;
+    }
+
+    virtual std::string name() const { return "memory"; }
+    virtual void close() const {}
+    virtual long size() const { return data_.size(); }
+
+private:
+    const std::string &data_;
+};
+
+double cpuSeconds()
+{
+    ::rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+std::uint64_t percentile(const std::vector<std::uint64_t> &sorted, double q)
+{
+    if (sorted.empty()) { return 0; }
+    auto index(std::size_t(q * sorted.size()));
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+} // namespace
+
+class Bench
+    : public service::Cmdline
+    , public http::ContentGenerator
+{
+public:
+    Bench()
+        : service::Cmdline("http-bench", BUILD_TARGET_VERSION)
+        , httpThreadCount_(boost::thread::hardware_concurrency())
+        , clientThreadCount_(1)
+        , connections_(16)
+        , pipeline_(1)
+        , payloads_({ 100, 4096, 65536 })
+        , mode_("both")
+        , transport_("tcp")
+        , duration_(5)
+        , warmup_(1)
+    {}
+
+private:
+    void configuration(po::options_description &cmdline
+                       , po::options_description &config
+                       , po::positional_options_description &pd);
+
+    void configure(const po::variables_map &vars);
+
+    int run();
+
+    virtual void generate_impl(const http::Request &request
+                               , const http::ServerSink::pointer &sink);
+
+    void scenario(const std::string &mode, std::size_t payload);
+
+    Stats drive(const std::string &path, double seconds);
+
+    unsigned int httpThreadCount_;
+    unsigned int clientThreadCount_;
+    std::size_t connections_;
+    std::size_t pipeline_;
+    std::vector<std::size_t> payloads_;
+    std::string mode_;
+    std::string transport_;
+    double duration_;
+    double warmup_;
+
+    /** Payloads by size.
+     */
+    std::map<std::size_t, std::string> data_;
+
+    asio::io_service ios_;
+    std::vector<std::unique_ptr<Client>> clients_;
+};
+
+void Bench::configuration(po::options_description &cmdline
+                          , po::options_description &config
+                          , po::positional_options_description &pd)
+{
+    config.add_options()
+        ("http.threadCount", po::value(&httpThreadCount_)
+         ->default_value(httpThreadCount_)->required()
+         , "Number of server HTTP threads.")
+        ("bench.clientThreads", po::value(&clientThreadCount_)
+         ->default_value(clientThreadCount_)->required()
+         , "Number of threads driving TCP client connections (memory "
+         "connections run in their own threads).")
+        ("bench.connections", po::value(&connections_)
+         ->default_value(connections_)->required()
+         , "Number of client connections.")
+        ("bench.pipeline", po::value(&pipeline_)
+         ->default_value(pipeline_)->required()
+         , "Number of pipelined requests per connection.")
+        ("bench.payload", po::value(&payloads_)->multitoken()
+         , "Payload sizes (bytes), default: 100 4096 65536.")
+        ("bench.mode", po::value(&mode_)
+         ->default_value(mode_)->required()
+         , "Response mode: buffered (content from memory), source "
+         "(DataSource) or both.")
+        ("bench.transport", po::value(&transport_)
+         ->default_value(transport_)->required()
+         , "Client transport: tcp (loopback socket) or memory (in-memory "
+         "stream, isolates library CPU cost from kernel networking).")
+        ("bench.duration", po::value(&duration_)
+         ->default_value(duration_)->required()
+         , "Measured duration of each scenario (seconds).")
+        ("bench.warmup", po::value(&warmup_)
+         ->default_value(warmup_)->required()
+         , "Warmup duration of each scenario (seconds).")
+        ;
+
+    (void) cmdline;
+    (void) pd;
+}
+
+void Bench::configure(const po::variables_map &vars)
+{
+    if ((mode_ != "buffered") && (mode_ != "source") && (mode_ != "both")) {
+        throw po::validation_error
+            (po::validation_error::invalid_option_value, "bench.mode");
+    }
+
+    if ((transport_ != "tcp") && (transport_ != "memory")) {
+        throw po::validation_error
+            (po::validation_error::invalid_option_value, "bench.transport");
+    }
+
+    if (!connections_ || !pipeline_ || !clientThreadCount_) {
+        throw po::validation_error
+            (po::validation_error::invalid_option_value
+             , "bench.connections");
+    }
+
+    for (auto payload : payloads_) {
+        data_[payload] = std::string(payload, 'x');
+    }
+
+    LOG(info3, log_)
+        << "Config:"
+        << "\n\thttp.threadCount = " << httpThreadCount_
+        << "\n\tbench.clientThreads = " << clientThreadCount_
+        << "\n\tbench.connections = " << connections_
+        << "\n\tbench.pipeline = " << pipeline_
+        << "\n\tbench.mode = " << mode_
+        << "\n\tbench.transport = " << transport_
+        << "\n\tbench.duration = " << duration_
+        << "\n\tbench.warmup = " << warmup_
+        ;
+
+    (void) vars;
+}
+
+void Bench::generate_impl(const http::Request &request
+                          , const http::ServerSink::pointer &sink)
+{
+    // path: /{buffered,source}/size
+    const auto slash(request.path.rfind('/'));
+    const auto fdata(data_.find(boost::lexical_cast<std::size_t>
+                                (request.path.substr(slash + 1))));
+    if (fdata == data_.end()) {
+        sink->error(http::NotFound("No such payload."));
+        return;
+    }
+
+    if (ba::starts_with(request.path, "/source/")) {
+        sink->content(std::make_shared<DataSource>(fdata->second));
+        return;
+    }
+
+    sink->content(fdata->second, { "application/octet-stream", -1 });
+}
+
+Stats Bench::drive(const std::string &path, double seconds)
+{
+    const auto deadline
+        (Clock::now() + std::chrono::microseconds
+         (std::int64_t(seconds * 1e6)));
+
+    std::atomic<std::size_t> running(clients_.size());
+    std::promise<void> finished;
+    const auto done([&]()
+    {
+        if (!--running) { finished.set_value(); }
+    });
+
+    for (auto &client : clients_) {
+        client->run(path, pipeline_, deadline, done);
+    }
+    finished.get_future().wait();
+
+    Stats stats;
+    for (const auto &client : clients_) { stats.merge(client->stats()); }
+    return stats;
+}
+
+void Bench::scenario(const std::string &mode, std::size_t payload)
+{
+    const auto path("/" + mode + "/" + std::to_string(payload));
+
+    drive(path, warmup_);
+
+    const auto cpu(cpuSeconds());
+    const auto allocs(allocations.load());
+    const auto start(Clock::now());
+
+    auto stats(drive(path, duration_));
+
+    const auto elapsed(std::chrono::duration<double>
+                       (Clock::now() - start).count());
+    const auto cpuUsed(cpuSeconds() - cpu);
+    const auto allocsUsed(allocations.load() - allocs);
+
+    std::sort(stats.latencies.begin(), stats.latencies.end());
+    const double requests(stats.requests ? stats.requests : 1);
+
+    std::printf("{\"mode\":\"%s\",\"transport\":\"%s\",\"payload\":%zu"
+                ",\"connections\":%zu"
+                ",\"pipeline\":%zu,\"serverThreads\":%u"
+                ",\"clientThreads\":%u,\"seconds\":%.3f"
+                ",\"requests\":%llu,\"errors\":%llu"
+                ",\"requestsPerSecond\":%.1f,\"bytesPerSecond\":%.1f"
+                ",\"latencyUs\":{\"p50\":%llu,\"p90\":%llu,\"p99\":%llu"
+                ",\"p999\":%llu,\"max\":%llu}"
+                ",\"cpuUsPerRequest\":%.3f"
+                ",\"allocationsPerRequest\":%.3f}\n"
+                , mode.c_str(), transport_.c_str(), payload, connections_
+                , pipeline_
+                , httpThreadCount_, clientThreadCount_, elapsed
+                , (unsigned long long) stats.requests
+                , (unsigned long long) stats.errors
+                , stats.requests / elapsed, stats.bytes / elapsed
+                , (unsigned long long) percentile(stats.latencies, 0.5)
+                , (unsigned long long) percentile(stats.latencies, 0.9)
+                , (unsigned long long) percentile(stats.latencies, 0.99)
+                , (unsigned long long) percentile(stats.latencies, 0.999)
+                , (unsigned long long) (stats.latencies.empty()
+                                        ? 0 : stats.latencies.back())
+                , cpuUsed * 1e6 / requests
+                , allocsUsed / requests);
+    std::fflush(stdout);
+}
+
+int Bench::run()
+{
+    http::Http http;
+    const auto local(http.listen(utility::TcpEndpoint("127.0.0.1:0"), *this));
+    http.startServer(httpThreadCount_);
+
+    // client machinery
+    boost::optional<asio::io_service::work> work(std::ref(ios_));
+    std::vector<std::thread> threads;
+    for (unsigned int i(0); i < clientThreadCount_; ++i) {
+        threads.emplace_back([this]() { ios_.run(); });
+    }
+
+    for (std::size_t i(0); i < connections_; ++i) {
+        if (transport_ == "memory") {
+            clients_.emplace_back(new MemoryClient(http.connect(*this)));
+            continue;
+        }
+
+        std::unique_ptr<TcpClient> client(new TcpClient(ios_));
+        client->connect(local.value);
+        clients_.push_back(std::move(client));
+    }
+
+    for (auto payload : payloads_) {
+        if (mode_ != "source") { scenario("buffered", payload); }
+        if (mode_ != "buffered") { scenario("source", payload); }
+    }
+
+    clients_.clear();
+    work = boost::none;
+    ios_.stop();
+    for (auto &thread : threads) { thread.join(); }
+
+    std::ostringstream os;
+    http.stat(os);
+    LOG(info3, log_) << "Server statistics:\n" << os.str();
+
+    http.stop();
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    return Bench()(argc, argv);
+}
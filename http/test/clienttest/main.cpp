@@ -1,11 +1,26 @@
 
-#include <vector>
-#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
-#include <unistd.h> // usleep
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 #include <boost/optional.hpp>
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/filesystem/path.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
 
 #include "dbglog/dbglog.hpp"
 
@@ -15,71 +30,220 @@
 #include "service/cmdline.hpp"
 
 #include "http/http.hpp"
-#include "http/resourcefetcher.hpp"
+#include "http/error.hpp"
 
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
+namespace asio = boost::asio;
+typedef std::chrono::steady_clock Clock;
+
+/** Bounded in-flight window: acquire() blocks while window is full.
+ */
+class Window {
+public:
+    Window(std::size_t size) : size_(size), inFlight_() {}
 
-std::atomic<int> active;
-std::atomic<int> succeded;
-std::atomic<int> finished;
-std::atomic<int> started;
+    void acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this]() { return inFlight_ < size_; });
+        ++inFlight_;
+    }
 
-class Task
-{
+    void release() {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            --inFlight_;
+        }
+        cond_.notify_all();
+    }
+
+    /** Waits until all requests are finished.
+     */
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this]() { return !inFlight_; });
+    }
+
+private:
+    const std::size_t size_;
+    std::size_t inFlight_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+};
+
+/** Collected results.
+ */
+struct Results {
+    std::atomic<std::uint64_t> succeeded;
+    std::atomic<std::uint64_t> failed;
+    std::atomic<std::uint64_t> bytes;
+
+    /** Latencies in microseconds.
+     */
+    std::vector<std::uint64_t> latencies;
+    std::mutex mutex;
+
+    Results() : succeeded(), failed(), bytes() {}
+
+    void record(Clock::time_point start, std::size_t size, bool ok) {
+        const auto latency
+            (std::chrono::duration_cast<std::chrono::microseconds>
+             (Clock::now() - start).count());
+        if (ok) { ++succeeded; bytes += size; } else { ++failed; }
+        std::unique_lock<std::mutex> lock(mutex);
+        latencies.push_back(latency);
+    }
+};
+
+class Sink : public http::ClientSink {
 public:
-    Task(const std::string &url) : query(url)
+    Sink(Window &window, Results &results, const std::string &location)
+        : window_(window), results_(results), location_(location)
+        , start_(Clock::now())
+    {}
+
+private:
+    virtual void content_impl(const void*, std::size_t size
+                              , const FileInfo&, bool
+                              , const http::Header::list*)
+    {
+        done(size, true);
+    }
+
+    virtual void error_impl(const std::exception_ptr &exc) {
+        try {
+            std::rethrow_exception(exc);
+        } catch (const std::exception &e) {
+            LOG(err2) << "Failed <" << location_ << ">: " << e.what();
+        } catch (...) {
+            LOG(err2) << "Failed <" << location_ << ">: unknown exception";
+        }
+        done(0, false);
+    }
+
+    virtual void error_impl(const std::error_code &ec
+                            , const std::string &message)
     {
-        active++;
-        started++;
-        query.timeout(5000);
+        LOG(err2) << "Failed <" << location_ << ">: " << ec
+                  << " (" << message << ").";
+        done(0, false);
     }
 
-    ~Task()
+    virtual void redirect_impl(const std::string&, utility::HttpCode
+                               , const CacheControl&)
     {
-        active--;
+        done(0, false);
+    }
+
+    void done(std::size_t size, bool ok) {
+        results_.record(start_, size, ok);
+        window_.release();
+    }
+
+    Window &window_;
+    Results &results_;
+    const std::string location_;
+    const Clock::time_point start_;
+};
+
+/** In-process server stand-in. Path /<latency>/<size> generates response of
+ *  given size after given latency (milliseconds).
+ */
+class Server : public http::ContentGenerator {
+public:
+    Server() : work_(std::ref(ios_)), thread_([this]() { ios_.run(); }) {}
+
+    ~Server() {
+        work_ = boost::none;
+        ios_.stop();
+        thread_.join();
     }
 
-    void done(http::ResourceFetcher::MultiQuery &&queries)
+    std::string path(long latency, std::size_t size) {
+        auto &data(data_[size]);
+        if (data.size() != size) { data.assign(size, 'x'); }
+        return "/" + std::to_string(latency) + "/" + std::to_string(size);
+    }
+
+private:
+    virtual void generate_impl(const http::Request &request
+                               , const http::ServerSink::pointer &sink)
     {
-        finished++;
-        http::ResourceFetcher::Query &q = *queries.begin();
-        if (q.exc())
+        long latency;
+        std::size_t size;
+        if (std::sscanf(request.path.c_str(), "/%ld/%zu", &latency, &size)
+            != 2)
         {
-            try
-            {
-                std::rethrow_exception(q.exc());
-            }
-            catch(std::exception &e)
-            {
-                LOG(err3) << "exception: " << e.what();
-            }
-            catch(...)
-            {
-                LOG(err3) << "unknown exception";
-            }
+            sink->error(http::NotFound("Invalid path."));
+            return;
         }
-        else if (q.valid())
-        {
-            succeded++;
-            const http::ResourceFetcher::Query::Body &body = q.get();
-            LOG(info3) << "Downloaded: '" << q.location()
-                       << "', size: " << body.data.length();
+
+        const auto fdata(data_.find(size));
+        if (fdata == data_.end()) {
+            sink->error(http::NotFound("Unknown payload."));
+            return;
         }
-        else
-            LOG(err3) << "Failed: " << q.location()
-                      << ", http code: " << q.ec().value();
+
+        const auto &data(fdata->second);
+        if (latency <= 0) {
+            sink->content(data.data(), data.size()
+                          , http::SinkBase::FileInfo(), false);
+            return;
+        }
+
+        auto timer(std::make_shared<asio::steady_timer>(ios_));
+        timer->expires_from_now(std::chrono::milliseconds(latency));
+        timer->async_wait([timer, sink, &data](const boost::system::error_code&)
+        {
+            sink->content(data.data(), data.size()
+                          , http::SinkBase::FileInfo(), false);
+        });
     }
 
-    http::ResourceFetcher::Query query;
+    /** Payloads, filled before server is started.
+     */
+    std::map<std::size_t, std::string> data_;
+
+    asio::io_service ios_;
+    boost::optional<asio::io_service::work> work_;
+    std::thread thread_;
 };
 
+/** Extracts value of given metric from Prometheus text.
+ */
+double metric(const std::string &text, const std::string &name)
+{
+    std::istringstream is(text);
+    std::string line;
+    while (std::getline(is, line)) {
+        if ((line.size() > name.size())
+            && !line.compare(0, name.size(), name)
+            && (line[name.size()] == ' '))
+        {
+            return std::atof(line.c_str() + name.size() + 1);
+        }
+    }
+    return 0;
+}
+
+std::uint64_t percentile(const std::vector<std::uint64_t> &sorted, double q)
+{
+    if (sorted.empty()) { return 0; }
+    auto index(std::size_t(q * sorted.size()));
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
 class Test : public service::Cmdline {
 public:
     Test()
         : service::Cmdline("http-clienttest", BUILD_TARGET_VERSION)
-        , targetDownloads_(100)
+        , targetDownloads_(10000)
         , threadCount_(2)
+        , serverThreadCount_(boost::thread::hardware_concurrency())
+        , window_(64)
+        , hosts_(1)
+        , latencies_({ 0 })
+        , payloads_({ 4096 })
     {}
 
 private:
@@ -99,6 +263,14 @@ private:
 usage
     http-clienttest [target-downloads-count [urls-file-path]] [OPTIONS]
 
+Measures CURL client throughput against in-process HTTP server. Server
+response latency and payload profiles are picked round-robin from
+--latency and --payload lists. When URL file is given, its URLs are fetched
+instead.
+
+Prints one JSON line with requests/s, latency percentiles and connection
+reuse rate (1 - sockets opened / transfers).
+
 )RAW";
         }
         return false;
@@ -109,6 +281,12 @@ usage
     std::size_t targetDownloads_;
     boost::optional<fs::path> urls_;
     std::size_t threadCount_;
+    std::size_t serverThreadCount_;
+    std::size_t window_;
+    std::size_t hosts_;
+    std::vector<long> latencies_;
+    std::vector<std::size_t> payloads_;
+    http::ContentFetcher::Options options_;
 };
 
 
@@ -120,12 +298,46 @@ void Test::configuration(po::options_description &cmdline
         ("count", po::value(&targetDownloads_)
          ->required()->default_value(targetDownloads_)
          , "Number of donwloads to perform.")
-         ("urls", po::value<fs::path>()
-          , "Path to URL file")
+        ("urls", po::value<fs::path>()
+         , "Path to URL file. Local server is used if not set.")
         ("threadCount", po::value(&threadCount_)
          ->default_value(threadCount_)->required()
          , "Number of HTTP threads (and CURL clients).")
-         ;
+        ("serverThreadCount", po::value(&serverThreadCount_)
+         ->default_value(serverThreadCount_)->required()
+         , "Number of local server threads.")
+        ("window", po::value(&window_)
+         ->default_value(window_)->required()
+         , "Maximum number of requests in flight.")
+        ("hosts", po::value(&hosts_)
+         ->default_value(hosts_)->required()
+         , "Number of distinct local server hosts (127.0.0.1, 127.0.0.2, ...).")
+        ("hostAffinity", po::value(&options_.hostAffinity)
+         ->default_value(options_.hostAffinity)->required()
+         , "Dispatch requests to client threads by host.")
+        ("hostAffinityMaxLoad", po::value(&options_.hostAffinityMaxLoad)
+         ->default_value(options_.hostAffinityMaxLoad)->required()
+         , "Maximum client load relative to average before spillover.")
+        ("maxHostTransfers", po::value(&options_.maxHostTransfers)
+         ->default_value(options_.maxHostTransfers)->required()
+         , "Maximum number of running transfers per host, 0 = unlimited.")
+        ("latency", po::value(&latencies_)->multitoken()
+         , "Server response latency profile (milliseconds), default: 0.")
+        ("payload", po::value(&payloads_)->multitoken()
+         , "Server response payload profile (bytes), default: 4096.")
+        ("maxHostConnections", po::value(&options_.maxHostConnections)
+         ->default_value(options_.maxHostConnections)->required()
+         , "CURL: maximum number of connections to single host.")
+        ("maxTotalConnections", po::value(&options_.maxTotalConections)
+         ->default_value(options_.maxTotalConections)->required()
+         , "CURL: maximum number of connections.")
+        ("maxCacheConnections", po::value(&options_.maxCacheConections)
+         ->default_value(options_.maxCacheConections)->required()
+         , "CURL: connection cache size.")
+        ("pipelining", po::value(&options_.pipelining)
+         ->default_value(options_.pipelining)->required()
+         , "CURL: pipelining/multiplexing mode.")
+        ;
 
     pd.add("count", 1).add("urls", 1);
 }
@@ -135,63 +347,130 @@ void Test::configure(const po::variables_map &vars)
     if (vars.count("urls")) {
         urls_ = vars["urls"].as<fs::path>();
     }
+
+    if (!window_ || latencies_.empty() || payloads_.empty()) {
+        throw po::validation_error
+            (po::validation_error::invalid_option_value, "window");
+    }
+
+    if (!hosts_ || (hosts_ > 254)) {
+        throw po::validation_error
+            (po::validation_error::invalid_option_value, "hosts");
+    }
 }
 
 int Test::run()
 {
-    std::vector<std::string> urls({
-        "https://www.melown.com/",
-        "https://www.melown.com/tutorials.html",
-        "https://www.melown.com/blog.html",
-    });
+    std::vector<std::string> urls;
+
+    // local server, lives until client is stopped
+    Server server;
+    http::Http serverHttp;
 
     if (urls_) {
         LOG(info4) << "Loading urls from file.";
         std::string line;
         std::ifstream f(urls_->string());
-        if (f.is_open()) {
-            urls.clear();
-            while (std::getline(f,line)) {
-                if (!line.empty()) {
-                    urls.push_back(line);
-                }
+        if (!f.is_open()) {
+            LOG(fatal) << "Failed to open specified file.";
+            return EXIT_FAILURE;
+        }
+        while (std::getline(f,line)) {
+            if (!line.empty()) { urls.push_back(line); }
+        }
+    } else {
+        // one listener per loopback host
+        std::vector<std::string> hosts;
+        for (std::size_t h(0); h < hosts_; ++h) {
+            const auto endpoint
+                (serverHttp.listen
+                 (utility::TcpEndpoint
+                  (str(boost::format("127.0.0.%d:0") % (h + 1))), server));
+            hosts.push_back
+                ("http://" + boost::lexical_cast<std::string>(endpoint.value));
+        }
+
+        // interleave profiles and hosts
+        const auto count(std::max(latencies_.size(), payloads_.size()));
+        for (std::size_t i(0); i < count; ++i) {
+            for (const auto &host : hosts) {
+                urls.push_back
+                    (host + server.path(latencies_[i % latencies_.size()]
+                                        , payloads_[i % payloads_.size()]));
             }
-            f.close();
-        } else {
-            LOG(warn4) << "Failed to open specified file.";
         }
-    }
-    LOG(info4) << "Will download from " << urls.size() << " urls.";
 
-    http::Http htt;
-    http::ResourceFetcher fetcher(htt.fetcher());
+        serverHttp.startServer(serverThreadCount_);
+    }
 
-    {
-        http::ContentFetcher::Options options;
-        options.maxTotalConections = 10;
-        options.pipelining = 2;
-        htt.startClient(threadCount_, &options);
+    if (urls.empty()) {
+        LOG(fatal) << "No URL to fetch.";
+        return EXIT_FAILURE;
     }
+    LOG(info4) << "Will download from " << urls.size() << " urls.";
 
-    for (unsigned long i = 0; i < targetDownloads_; i++)
-    {
-        while (active > 25)
-            usleep(1000);
-        auto t = std::make_shared<Task>(urls[rand() % urls.size()]);
-        fetcher.perform(t->query, std::bind(&Task::done, t,
-                                            std::placeholders::_1));
+    http::Http htt;
+    htt.startClient(threadCount_, &options_);
+    auto &fetcher(htt.fetcher());
+
+    Window window(window_);
+    Results results;
+    results.latencies.reserve(targetDownloads_);
+
+    const auto start(Clock::now());
+    for (std::size_t i(0); i < targetDownloads_; ++i) {
+        window.acquire();
+        const auto &url(urls[i % urls.size()]);
+        fetcher.fetch(url, std::make_shared<Sink>(window, results, url));
     }
+    window.drain();
+    const auto elapsed(std::chrono::duration<double>
+                       (Clock::now() - start).count());
+
+    std::ostringstream os;
+    htt.metrics(os);
+    const auto metrics(os.str());
+    const auto transfers(metric(metrics, "http_client_transfers_total"));
+    const auto sockets(metric(metrics, "http_client_sockets_opened_total"));
+    const auto spillovers
+        (metric(metrics, "http_client_dispatch_spillovers_total"));
+    const auto queued(metric(metrics, "http_client_transfers_queued_total"));
 
     LOG(info3) << "Waiting for threads to stop.";
     htt.stop();
-
-    LOG(info4) << "Client stopped"
-               << ", downloads started: " << started
-               << ", finished: " << finished
-               << ", succeded: " << succeded
-               << ".";
-
-    return EXIT_SUCCESS;
+    serverHttp.stop();
+
+    auto &latencies(results.latencies);
+    std::sort(latencies.begin(), latencies.end());
+
+    std::printf("{\"requests\":%llu,\"failed\":%llu,\"seconds\":%.3f"
+                ",\"requestsPerSecond\":%.1f,\"bytesPerSecond\":%.1f"
+                ",\"latencyUs\":{\"p50\":%llu,\"p99\":%llu,\"max\":%llu}"
+                ",\"transfers\":%.0f,\"socketsOpened\":%.0f"
+                ",\"connectionReuse\":%.4f,\"spillovers\":%.0f,\"queued\":%.0f"
+                ",\"threadCount\":%zu,\"hosts\":%zu,\"hostAffinity\":%s"
+                ",\"window\":%zu,\"maxHostTransfers\":%lu"
+                ",\"maxHostConnections\":%lu"
+                ",\"maxTotalConnections\":%lu,\"maxCacheConnections\":%lu"
+                ",\"pipelining\":%ld}\n"
+                , (unsigned long long) results.succeeded.load()
+                , (unsigned long long) results.failed.load()
+                , elapsed, latencies.size() / elapsed
+                , results.bytes / elapsed
+                , (unsigned long long) percentile(latencies, 0.5)
+                , (unsigned long long) percentile(latencies, 0.99)
+                , (unsigned long long) (latencies.empty()
+                                        ? 0 : latencies.back())
+                , transfers, sockets
+                , (transfers ? (1.0 - (sockets / transfers)) : 0.0)
+                , spillovers, queued, threadCount_, hosts_
+                , (options_.hostAffinity ? "true" : "false")
+                , window_, options_.maxHostTransfers
+                , options_.maxHostConnections
+                , options_.maxTotalConections, options_.maxCacheConections
+                , options_.pipelining);
+
+    return results.failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 int main(int argc, char *argv[])
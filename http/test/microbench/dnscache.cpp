@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** DNS cache benchmarks.
+ */
+
+#include <boost/asio.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include "http/detail/dnscache.hpp"
+
+namespace detail = http::detail;
+namespace asio = boost::asio;
+
+namespace {
+
+/** Cached lookup (handler is called right away).
+ */
+void BM_dnsCacheHit(benchmark::State &state)
+{
+    asio::io_service ios;
+    detail::DnsCache cache;
+
+    std::size_t resolved(0);
+    auto handler([&](const boost::system::error_code &ec
+                     , const detail::DnsCache::EndpointsPointer &endpoints)
+    {
+        if (!ec && endpoints && !endpoints->empty()) { ++resolved; }
+    });
+
+    // populate cache
+    cache.resolve(ios, "127.0.0.1", "8080", handler);
+    ios.run();
+    if (!resolved) {
+        state.SkipWithError("Unable to resolve.");
+        return;
+    }
+
+    for (auto _ : state) {
+        cache.resolve(ios, "127.0.0.1", "8080", handler);
+    }
+
+    if (cache.misses() != 1) {
+        state.SkipWithError("Unexpected cache miss.");
+    }
+    cache.forget(ios);
+}
+
+} // namespace
+
+BENCHMARK(BM_dnsCacheHit);
@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** Header handling benchmarks.
+ */
+
+#include <string>
+#include <vector>
+
+#include <boost/asio/streambuf.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include "http/detail/types.hpp"
+#include "http/detail/headers.hpp"
+#include "http/detail/httpdate.hpp"
+
+namespace detail = http::detail;
+
+namespace {
+
+/** Typical browser request headers.
+ */
+http::Request browserRequest()
+{
+    http::Request request;
+    request.headers = {
+        { "Host", "www.example.com" }
+        , { "Connection", "keep-alive" }
+        , { "User-Agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36"
+            " (KHTML, like Gecko) Chrome/75.0.3770.100 Safari/537.36" }
+        , { "Accept", "text/html,application/xhtml+xml,application/xml;q=0.9"
+            ",image/webp,*/*;q=0.8" }
+        , { "Accept-Encoding", "gzip, deflate, br" }
+        , { "Accept-Language", "en-US,en;q=0.9,cs;q=0.8" }
+        , { "Cookie", "_ga=GA1.2.1234567890.1561234567; session=0123456789"
+            "abcdef0123456789abcdef" }
+        , { "If-Modified-Since", "Tue, 25 Jun 2019 10:28:01 GMT" }
+        , { "X-Requested-With", "XMLHttpRequest" }
+    };
+    request.indexHeaders();
+    return request;
+}
+
+void BM_formatHttpDate(benchmark::State &state)
+{
+    std::time_t now(1561458481);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(detail::formatHttpDate(now));
+    }
+}
+
+void BM_getHeaderKnown(benchmark::State &state)
+{
+    const auto request(browserRequest());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize
+            (request.getHeader(http::KnownHeader::ifModifiedSince));
+    }
+}
+
+void BM_getHeaderByName(benchmark::State &state)
+{
+    const auto request(browserRequest());
+    const std::string known("accept-language");
+    const std::string unknown("X-Requested-With");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(request.getHeader(known));
+        benchmark::DoNotOptimize(request.getHeader(unknown));
+    }
+}
+
+void BM_writeResponseHeader(benchmark::State &state)
+{
+    detail::Response response(detail::StatusCode::OK);
+    response.headers = {
+        { "Content-Type", "image/jpeg" }
+        , { "Last-Modified", "Tue, 25 Jun 2019 10:28:01 GMT" }
+        , { "Cache-Control", "max-age=604800, public" }
+        , { "Access-Control-Allow-Origin", "*" }
+        , { "ETag", "\"5d0fa7e1-1c3a2\"" }
+    };
+    const std::string server("melown-http/1.9");
+
+    boost::asio::streambuf buf;
+    for (auto _ : state) {
+        std::ostream os(&buf);
+        detail::writeResponseHeader(os, "HTTP/1.1", response, server);
+        os << "Content-Length: " << 115618 << "\r\n\r\n";
+        state.SetBytesProcessed(state.bytes_processed() + buf.size());
+        buf.consume(buf.size());
+    }
+}
+
+void BM_chunkHeader(benchmark::State &state)
+{
+    const std::size_t size(std::size_t(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(detail::chunkHeader(size));
+    }
+}
+
+void BM_parseCacheControl(benchmark::State &state)
+{
+    const std::vector<std::string> values = {
+        "max-age=604800, public"
+        , "public, s-maxage=3600, max-age=60"
+        , "no-cache, no-store, must-revalidate"
+        , "private, max-age=0"
+    };
+    for (auto _ : state) {
+        for (const auto &value : values) {
+            benchmark::DoNotOptimize(detail::parseCacheControl(value));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+
+} // namespace
+
+BENCHMARK(BM_formatHttpDate);
+BENCHMARK(BM_getHeaderKnown);
+BENCHMARK(BM_getHeaderByName);
+BENCHMARK(BM_writeResponseHeader);
+BENCHMARK(BM_chunkHeader)->Arg(0)->Arg(4096)->Arg(1 << 20);
+BENCHMARK(BM_parseCacheControl);
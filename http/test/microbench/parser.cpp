@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2019 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/** Request parser benchmarks.
+ */
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "http/detail/parser.hpp"
+#include "http/detail/scan.hpp"
+
+namespace detail = http::detail;
+
+namespace {
+
+/** Desktop browser page/asset requests.
+ */
+const std::vector<std::string> browserCorpus = {
+    "GET /index.html HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+    "(KHTML, like Gecko) Chrome/75.0.3770.100 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+    "image/webp,image/apng,*/*;q=0.8,application/signed-exchange;v=b3\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9,cs;q=0.8\r\n"
+    "Cookie: _ga=GA1.2.1234567890.1561234567; _gid=GA1.2.987654321."
+    "1561234567; session=0123456789abcdef0123456789abcdef\r\n"
+    "If-Modified-Since: Tue, 25 Jun 2019 10:28:01 GMT\r\n"
+    "\r\n"
+
+    , "GET /static/js/app.6d3f1c2b.js HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64; rv:67.0) "
+    "Gecko/20100101 Firefox/67.0\r\n"
+    "Accept: */*\r\n"
+    "Referer: https://www.example.com/index.html\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "If-None-Match: \"5d0fa7e1-1c3a2\"\r\n"
+    "\r\n"
+};
+
+/** Map client tile requests: short headers, long query strings.
+ */
+const std::vector<std::string> tileCorpus = {
+    "GET /mario/tiles/15-17678-11100.terrain?"
+    "ts=1561234567&v=3&lod=15&x=17678&y=11100&fmt=qmesh HTTP/1.1\r\n"
+    "Host: tiles.example.com\r\n"
+    "Accept: */*\r\n"
+    "Origin: https://maps.example.com\r\n"
+    "Accept-Encoding: gzip\r\n"
+    "\r\n"
+
+    , "GET /mario/tiles/./16/35357/../35356/22201.jpg?"
+    "layer=ortho%2B2019&style=default&tilematrixset=web%20mercator HTTP/1.1\r\n"
+    "Host: tiles.example.com\r\n"
+    "User-Agent: vts-browser/2.8\r\n"
+    "Range: bytes=0-65535\r\n"
+    "\r\n"
+};
+
+/** Request split into lines.
+ */
+struct Lines {
+    std::vector<std::pair<const char*, std::size_t>> lines;
+
+    Lines(const std::string &request) {
+        const char *b(request.data());
+        const char *e(b + request.size());
+        while (b != e) {
+            auto lf(detail::scan::find(b, e, '\n'));
+            lines.emplace_back(b, lf - b + 1);
+            b = lf + 1;
+        }
+    }
+};
+
+void parse(benchmark::State &state, const std::vector<std::string> &corpus)
+{
+    std::vector<Lines> requests(corpus.begin(), corpus.end());
+
+    std::size_t bytes(0);
+    for (const auto &request : corpus) { bytes += request.size(); }
+
+    detail::Request request;
+    for (auto _ : state) {
+        for (const auto &r : requests) {
+            request.clear();
+            auto il(r.lines.begin());
+            detail::parseRequestLine(request, il->first, il->second);
+            // skip request line and empty line
+            for (++il; il->second > 2; ++il) {
+                detail::parseHeaderLine(request, il->first, il->second);
+            }
+            request.indexHeaders();
+            benchmark::DoNotOptimize(request);
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetItemsProcessed(state.iterations() * corpus.size());
+}
+
+void BM_parseBrowser(benchmark::State &state)
+{
+    parse(state, browserCorpus);
+}
+
+void BM_parseTile(benchmark::State &state)
+{
+    parse(state, tileCorpus);
+}
+
+void BM_splitUri(benchmark::State &state)
+{
+    detail::Request request;
+    const std::string uri
+        ("/mario/tiles/./16/35357/../35356/22201%2Ejpg?"
+         "layer=ortho%2B2019&style=default");
+    for (auto _ : state) {
+        request.uri = uri;
+        detail::splitUri(request);
+        benchmark::DoNotOptimize(request.path);
+    }
+}
+
+void BM_findColon(benchmark::State &state)
+{
+    const std::string line(std::size_t(state.range(0)), 'a');
+    for (auto _ : state) {
+        benchmark::DoNotOptimize
+            (detail::scan::find(line.data(), line.data() + line.size()
+                                , ':'));
+    }
+    state.SetBytesProcessed(state.iterations() * line.size());
+}
+
+} // namespace
+
+BENCHMARK(BM_parseBrowser);
+BENCHMARK(BM_parseTile);
+BENCHMARK(BM_splitUri);
+BENCHMARK(BM_findColon)->Arg(16)->Arg(64)->Arg(256);